@@ -0,0 +1,305 @@
+#include "analysis.h"
+#include "trace.h"
+
+#define I_UNKNOWN   0xFFFF      // I can't be known statically here
+#define NOT_VISITED 0xFFFE
+#define WALK_STACK  16384       // Each address is walked at most twice, with 2 successors
+
+typedef struct {
+    uint16_t addr;
+    uint16_t I;     // Value of I on the way in, or I_UNKNOWN
+} walk_item_t;
+
+static inline uint16_t fetch(const uint8_t *ram, const uint16_t addr) {
+    return (ram[addr] << 8) | ram[addr + 1];
+}
+
+// 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1
+static inline bool is_skip(const uint16_t opcode) {
+    switch (opcode >> 12) {
+        case 0x3: case 0x4: case 0x9: return true;
+        case 0x5: return (opcode & 0xF) == 0;
+        case 0xE: return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+        default:  return false;
+    }
+}
+
+// Mark len bytes from I, if I is known
+static void mark_range(analysis_t *analysis, const uint16_t I, const uint16_t len, const uint8_t flag) {
+    if (I == I_UNKNOWN) return;
+    for (uint32_t addr = I; addr < (uint32_t)I + len && addr < sizeof analysis->flags; addr++)
+        analysis->flags[addr] |= flag;
+}
+
+// Follow every path from the entry point, tracking the value of I where it's known so
+//   sprite and register load/store addresses can be marked as data. An address is walked
+//   again if it's reached with a different I, then with I unknown, so this always ends.
+static void walk(analysis_t *analysis, const uint8_t *ram) {
+    static uint16_t seen_I[4096];
+    static walk_item_t stack[WALK_STACK];
+    uint32_t top = 0;
+
+    for (uint32_t i = 0; i < 4096; i++) seen_I[i] = NOT_VISITED;
+
+    stack[top++] = (walk_item_t){CHIP8_ENTRY_POINT, I_UNKNOWN};
+    analysis->flags[CHIP8_ENTRY_POINT] |= ANALYSIS_LEADER;
+
+    #define PUSH(a, i) do { \
+        if ((a) < 4095 && top < WALK_STACK) stack[top++] = (walk_item_t){(a), (i)}; \
+        if ((a) < 4096) analysis->flags[(a)] |= ANALYSIS_LEADER; \
+    } while (0)
+
+    while (top > 0) {
+        const walk_item_t item = stack[--top];
+        uint16_t addr = item.addr;
+        uint16_t I = item.I;
+
+        while (addr < 4095) {
+            // Stop if this address was already walked with the same or less knowledge of I
+            if (seen_I[addr] == NOT_VISITED) seen_I[addr] = I;
+            else if (seen_I[addr] == I || seen_I[addr] == I_UNKNOWN) break;
+            else seen_I[addr] = I = I_UNKNOWN;
+
+            analysis->flags[addr] |= ANALYSIS_CODE;
+            const uint16_t opcode = fetch(ram, addr);
+            const uint16_t NNN = opcode & 0x0FFF;
+            const uint8_t X = (opcode >> 8) & 0x0F;
+            const uint16_t next = addr + 2;
+
+            if (is_skip(opcode)) {
+                PUSH(next + 2, I);
+                PUSH(next, I);
+                break;
+            }
+
+            bool ends = false;
+            switch (opcode >> 12) {
+                case 0x0:
+                    if (opcode == 0x00EE) ends = true;     // Return, where to is the caller's business
+                    break;
+
+                case 0x1:
+                    PUSH(NNN, I);
+                    ends = true;
+                    break;
+
+                case 0x2:
+                    // The subroutine may change I, so it's unknown after it returns
+                    PUSH(next, I_UNKNOWN);
+                    PUSH(NNN, I);
+                    if (NNN < 4096) analysis->flags[NNN] |= ANALYSIS_CALLED;
+                    ends = true;
+                    break;
+
+                case 0xA:
+                    I = NNN;
+                    break;
+
+                case 0xB:
+                    analysis->flags[addr] |= ANALYSIS_COMPUTED;
+                    ends = true;
+                    break;
+
+                case 0xD:
+                    mark_range(analysis, I, opcode & 0xF, ANALYSIS_DATA);
+                    break;
+
+                case 0xF:
+                    switch (opcode & 0xFF) {
+                        case 0x1E: case 0x29:
+                            I = I_UNKNOWN;
+                            break;
+
+                        case 0x33:
+                            mark_range(analysis, I, 3, ANALYSIS_DATA | ANALYSIS_WRITTEN);
+                            if (I == I_UNKNOWN) analysis->flags[addr] |= ANALYSIS_BLIND;
+                            break;
+
+                        case 0x55: case 0x65: {
+                            const bool store = (opcode & 0xFF) == 0x55;
+                            mark_range(analysis, I, X + 1, ANALYSIS_DATA | (store ? ANALYSIS_WRITTEN : 0));
+                            if (store && I == I_UNKNOWN) analysis->flags[addr] |= ANALYSIS_BLIND;
+                            if (analysis->extension == CHIP8 && I != I_UNKNOWN)
+                                I = (I + X + 1) & 0xFFF;    // CHIP8 increments I
+                            break;
+                        }
+
+                        default:
+                            break;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+            if (ends) break;
+
+            addr = next;
+        }
+    }
+
+    #undef PUSH
+}
+
+// Split the walked code into basic blocks, each running from a leader up to a control
+//   flow instruction or the next leader
+static void build_blocks(analysis_t *analysis, const uint8_t *ram) {
+    for (uint32_t start = 0; start < 4095; start++) {
+        const uint8_t flags = analysis->flags[start];
+        if (!(flags & ANALYSIS_CODE) || !(flags & ANALYSIS_LEADER)) continue;
+        if (analysis->block_count == ANALYSIS_MAX_BLOCKS) break;
+
+        basic_block_t *block = &analysis->blocks[analysis->block_count++];
+        *block = (basic_block_t){.start = start, .kind = BLOCK_END};
+
+        uint32_t addr = start;
+        while (addr < 4095) {
+            const uint16_t opcode = fetch(ram, addr);
+            const uint16_t next = addr + 2;
+            const uint16_t NNN = opcode & 0x0FFF;
+
+            if (is_skip(opcode)) {
+                *block = (basic_block_t){start, next, {next, next + 2}, 2, BLOCK_SKIP};
+                break;
+            } else if (opcode == 0x00EE) {
+                *block = (basic_block_t){start, next, {0}, 0, BLOCK_RETURN};
+                break;
+            } else if (opcode >> 12 == 0x1) {
+                *block = (basic_block_t){start, next, {NNN}, 1, BLOCK_JUMP};
+                break;
+            } else if (opcode >> 12 == 0x2) {
+                *block = (basic_block_t){start, next, {NNN, next}, 2, BLOCK_CALL};
+                break;
+            } else if (opcode >> 12 == 0xB) {
+                *block = (basic_block_t){start, next, {0}, 0, BLOCK_COMPUTED};
+                break;
+            } else if (next < 4096 && (analysis->flags[next] & ANALYSIS_LEADER)) {
+                *block = (basic_block_t){start, next, {next}, 1, BLOCK_FALLTHROUGH};
+                break;
+            }
+
+            addr = next;
+            block->end = addr;
+        }
+    }
+}
+
+void analyze_rom(analysis_t *analysis, const rom_t *rom, const extension_t extension) {
+    memset(analysis, 0, sizeof *analysis);
+    analysis->rom_hash = rom->hash;
+    analysis->rom_size = rom->size;
+    analysis->extension = extension;
+
+    walk(analysis, rom->image);
+    build_blocks(analysis, rom->image);
+
+    for (uint32_t addr = 0; addr < 4096; addr++) {
+        if (analysis->flags[addr] & ANALYSIS_CODE) analysis->code_bytes += 2;
+        if (analysis->flags[addr] & ANALYSIS_DATA) analysis->data_bytes++;
+        if (analysis->flags[addr] & ANALYSIS_COMPUTED) analysis->computed_jumps++;
+        if (analysis->flags[addr] & ANALYSIS_BLIND) analysis->blind_stores++;
+    }
+}
+
+const analysis_t *analysis_get(const rom_t *rom, const extension_t extension) {
+    static analysis_t cache[ANALYSIS_CACHE_SIZE];
+    static uint32_t next_slot;
+
+    for (uint32_t i = 0; i < ANALYSIS_CACHE_SIZE; i++) {
+        const analysis_t *cached = &cache[i];
+        if (cached->block_count && cached->rom_hash == rom->hash &&
+            cached->rom_size == rom->size && cached->extension == extension)
+            return cached;
+    }
+
+    // Not analyzed yet, replace the oldest entry
+    analysis_t *analysis = &cache[next_slot++ % ANALYSIS_CACHE_SIZE];
+    analyze_rom(analysis, rom, extension);
+    return analysis;
+}
+
+bool analysis_may_use_sound(const analysis_t *analysis, const rom_t *rom) {
+    if (analysis->computed_jumps || analysis->blind_stores) return true;
+
+    for (uint32_t addr = CHIP8_ENTRY_POINT; addr + 1 < 4096; addr++) {
+        const uint8_t flags = analysis->flags[addr];
+        if ((flags & ANALYSIS_CODE) && (flags & ANALYSIS_WRITTEN)) return true;
+        if ((flags & ANALYSIS_CODE) && (rom->image[addr] & 0xF0) == 0xF0 && rom->image[addr + 1] == 0x18) 
+            return true;
+    }
+    return false;
+}
+
+static const basic_block_t *find_block(const analysis_t *analysis, const uint16_t start) {
+    uint32_t lo = 0, hi = analysis->block_count;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) / 2;
+        if (analysis->blocks[mid].start < start) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < analysis->block_count && analysis->blocks[lo].start == start ? &analysis->blocks[lo] : NULL;
+}
+
+static const char *block_end_names[] = {"falls through", "jump", "call", "return", "skip", "computed jump", "end of RAM"};
+
+void analysis_print(const analysis_t *analysis, const rom_t *rom, FILE *out) {
+    fprintf(out, "; %s: %u blocks, %u code bytes, %u data bytes, %u computed jumps, %u blind stores\n",
+            rom->name, analysis->block_count, analysis->code_bytes, analysis->data_bytes,
+            analysis->computed_jumps, analysis->blind_stores);
+
+    const uint32_t rom_end = CHIP8_ENTRY_POINT + rom->size;
+    uint32_t addr = CHIP8_ENTRY_POINT;
+    while (addr < rom_end) {
+        const uint8_t flags = analysis->flags[addr];
+
+        if (flags & ANALYSIS_CODE) {
+            const basic_block_t *block = (flags & ANALYSIS_LEADER) ? find_block(analysis, addr) : NULL;
+            if (block) {
+                fprintf(out, "\nblock_%03X:%s ; %s", addr,
+                        (flags & ANALYSIS_CALLED) ? " (subroutine)" : "", block_end_names[block->kind]);
+                for (uint8_t i = 0; i < block->succ_count; i++)
+                    fprintf(out, "%s0x%03X", i ? ", " : " -> ", block->succ[i]);
+                fputc('\n', out);
+            }
+
+            const uint16_t opcode = fetch(rom->image, addr);
+            char desc[TRACE_DESC_SIZE];
+            disassemble_opcode(opcode, desc, sizeof desc);
+            fprintf(out, "0x%03X: %04X  %s%s\n", addr, opcode, desc,
+                    (flags & ANALYSIS_WRITTEN) ? "  ; written by the ROM" : "");
+            addr += 2;
+            continue;
+        }
+
+        // Non code bytes, up to 8 a row of the same kind
+        const bool data = flags & ANALYSIS_DATA;
+        fprintf(out, "0x%03X:", addr);
+        uint32_t i = 0;
+        for (; i < 8 && addr + i < rom_end; i++) {
+            const uint8_t f = analysis->flags[addr + i];
+            if ((f & ANALYSIS_CODE) || (bool)(f & ANALYSIS_DATA) != data) break;
+            fprintf(out, " %02X", rom->image[addr + i]);
+        }
+        fprintf(out, "%*s  ; %s\n", (int)(8 - i) * 3, "", data ? "data" : "unreached");
+        addr += i;
+    }
+}
+
+void analysis_print_dot(const analysis_t *analysis, const rom_t *rom, FILE *out) {
+    fprintf(out, "digraph \"%s\" {\n    node [shape=box fontname=monospace];\n", rom->name);
+
+    for (uint32_t b = 0; b < analysis->block_count; b++) {
+        const basic_block_t *block = &analysis->blocks[b];
+        fprintf(out, "    b%03X [label=\"0x%03X-0x%03X\\n%s\"%s];\n", block->start, block->start,
+                block->end - 2, block_end_names[block->kind],
+                (analysis->flags[block->start] & ANALYSIS_CALLED) ? " style=bold" : "");
+
+        for (uint8_t i = 0; i < block->succ_count; i++) {
+            const char *style = block->kind == BLOCK_CALL ? (i == 0 ? " [style=dashed label=call]" : "") :
+                                block->kind == BLOCK_SKIP && i == 1 ? " [label=skip]" : "";
+            fprintf(out, "    b%03X -> b%03X%s;\n", block->start, block->succ[i], style);
+        }
+    }
+
+    fprintf(out, "}\n");
+}
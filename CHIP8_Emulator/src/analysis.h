@@ -0,0 +1,75 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+// Static ROM analysis: follows every path from the entry point through jumps, calls,
+//   returns and skips to find which bytes are instructions, splits them into basic blocks
+//   (the control flow graph) and marks the bytes ANNN + DXYN/FX33/FX55/FX65 touch as data.
+//   BNNN jumps to V0 + NNN can't be followed, so they're flagged and code only reached
+//   through them is missing, and FX33/FX55 with I unknown could write anywhere, code
+//   included. Anything compiling or predecoding ahead of time should only trust
+//   ANALYSIS_CODE bytes, and fall back to interpreting if computed_jumps or blind_stores
+//   isn't 0.
+
+#include "chip8.h"
+
+#define ANALYSIS_MAX_BLOCKS 2048
+#define ANALYSIS_CACHE_SIZE 8       // ROMs kept analyzed by analysis_get
+
+// Per byte flags
+#define ANALYSIS_CODE     0x01      // An instruction starts here
+#define ANALYSIS_DATA     0x02      // Read as data: sprites, FX65 loads
+#define ANALYSIS_WRITTEN  0x04      // Written by FX33/FX55, may be self modifying code
+#define ANALYSIS_LEADER   0x08      // A basic block starts here
+#define ANALYSIS_CALLED   0x10      // Subroutine entry (2NNN target)
+#define ANALYSIS_COMPUTED 0x20      // BNNN computed jump
+#define ANALYSIS_BLIND    0x40      // FX33/FX55 with I unknown, may write anywhere
+
+// How a basic block ends, which decides its successors
+typedef enum {
+    BLOCK_FALLTHROUGH,  // Runs into the next leader, succ[0] is the next block
+    BLOCK_JUMP,         // 1NNN, succ[0] is the target
+    BLOCK_CALL,         // 2NNN, succ[0] is the subroutine, succ[1] the return address
+    BLOCK_RETURN,       // 00EE, no static successors
+    BLOCK_SKIP,         // 3XNN/4XNN/5XY0/9XY0/EX9E/EXA1, succ[0] next, succ[1] skipped to
+    BLOCK_COMPUTED,     // BNNN, successors unknown
+    BLOCK_END,          // Ran off the end of RAM
+} block_end_t;
+
+typedef struct {
+    uint16_t start;         // First instruction
+    uint16_t end;           // Address after the last instruction
+    uint16_t succ[2];
+    uint8_t succ_count;
+    block_end_t kind;
+} basic_block_t;
+
+typedef struct {
+    uint32_t rom_hash;      // ROM and quirks profile this is the analysis of
+    uint32_t rom_size;
+    extension_t extension;
+    uint8_t flags[4096];    // ANALYSIS_* per RAM byte
+    basic_block_t blocks[ANALYSIS_MAX_BLOCKS];     // Sorted by start address
+    uint16_t block_count;
+    uint16_t computed_jumps;    // Number of BNNN instructions reached
+    uint16_t blind_stores;      // Number of FX33/FX55 reached with I unknown
+    uint32_t code_bytes;
+    uint32_t data_bytes;
+} analysis_t;
+
+// Analyze rom as run with the extension's quirks (FX55/FX65 I increment)
+void analyze_rom(analysis_t *analysis, const rom_t *rom, const extension_t extension);
+
+// Analysis of rom from the cache, analyzing it the first time it's asked for
+const analysis_t *analysis_get(const rom_t *rom, const extension_t extension);
+
+// False only if no reachable instruction is FX18, so the ROM can never make a sound. 
+//   Computed jumps, writes into code or stores with I unknown make it give up and say true.
+bool analysis_may_use_sound(const analysis_t *analysis, const rom_t *rom);
+
+// Write a disassembly of the ROM: blocks with their successors, code and data bytes
+void analysis_print(const analysis_t *analysis, const rom_t *rom, FILE *out);
+
+// Write the control flow graph in graphviz dot format
+void analysis_print_dot(const analysis_t *analysis, const rom_t *rom, FILE *out);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,211 @@
+#include "audio.h"
+
+// Set up audio state for the emulator and synth, offline rendering runs the synth
+//   in lockstep with emulated time with no added latency
+void audio_init(audio_t *audio, const config_t *config, const bool offline) {
+    memset(audio, 0, sizeof *audio);
+    audio->config = config;
+    audio->offline = offline;
+    audio->tone_freq = config->square_wave_freq;
+}
+
+// Push a sound event for the audio callback, sample_offset is relative to the start of 
+//   the current emulated frame. Returns false if the ring is full and the event was dropped.
+bool audio_push_event(audio_t *audio, const audio_event_type_t type, 
+                      const uint32_t freq, const uint32_t sample_offset) {
+    const uint32_t head = atomic_load_explicit(&audio->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&audio->tail, memory_order_acquire);
+
+    if (head - tail == AUDIO_RING_SIZE) return false;   // Full, callback is not keeping up
+
+    audio->events[head & (AUDIO_RING_SIZE - 1)] = (audio_event_t){
+        .sample = audio->frame_sample + sample_offset,
+        .host_time = monotonic_ns(),
+        .freq = freq,
+        .type = type,
+    };
+    atomic_store_explicit(&audio->head, head + 1, memory_order_release);
+    return true;
+}
+// Push sound on/off and pitch changes, only when the state actually changes
+void audio_set_sound(audio_t *audio, const config_t config, const bool on, const uint32_t sample_offset) {
+    if (audio->freq != config.square_wave_freq) {
+        audio->freq = config.square_wave_freq;
+        audio_push_event(audio, AUDIO_EVENT_PITCH, audio->freq, sample_offset);
+    }
+
+    if (on != audio->sound_on &&
+        audio_push_event(audio, on ? AUDIO_EVENT_ON : AUDIO_EVENT_OFF, 0, sample_offset))
+        audio->sound_on = on;
+}
+
+// Advance emulated sample clock to the start of the next frame
+void audio_end_frame(audio_t *audio, const config_t config) {
+    audio->frames++;
+    audio->frame_sample = audio->frames * config.audio_sample_rate / 60;
+}
+
+// Square wave synth, fill out samples applying sound events as their sample time comes up
+void audio_render(audio_t *audio, int16_t *out, const uint32_t samples) {
+    const config_t *config = audio->config;
+    const int64_t latency_samples = audio->offline ? 0 : 
+                                    (int64_t)config->audio_latency_ms * config->audio_sample_rate / 1000;
+
+    uint32_t tail = atomic_load_explicit(&audio->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&audio->head, memory_order_acquire);
+
+    for (uint32_t i = 0; i < samples; i++) {
+        const uint64_t now = audio->device_sample + i;
+
+        // Apply all events that are due at this sample
+        while (tail != head) {
+            const audio_event_t *event = &audio->events[tail & (AUDIO_RING_SIZE - 1)];
+
+            // (Re)sync emulated and device sample clocks if they drifted more than a buffer apart,
+            //   e.g. on startup or after the emulator was paused
+            const int64_t due = (int64_t)event->sample + audio->clock_offset + latency_samples;
+            if (!audio->offline && 
+                (!audio->clock_synced || due < (int64_t)now - (int64_t)samples || 
+                 due > (int64_t)now + latency_samples + (int64_t)samples)) {
+                audio->clock_offset = (int64_t)now - (int64_t)event->sample;
+                audio->clock_synced = true;
+                continue;
+            }
+            if (due > (int64_t)now) break;
+
+            switch (event->type) {
+                case AUDIO_EVENT_ON:  audio->tone_on = true;  break;
+                case AUDIO_EVENT_OFF: audio->tone_on = false; break;
+                case AUDIO_EVENT_PITCH: 
+                    if (event->freq) audio->tone_freq = event->freq; 
+                    break;
+            }
+
+            // Measured latency is the time from the push until this sample leaves the device buffer
+            if (!audio->offline) {
+                const uint64_t elapsed_ns = monotonic_ns() - event->host_time;
+                const uint32_t latency_us = (uint32_t)(elapsed_ns / 1000) +
+                                            (uint32_t)((uint64_t)(samples - i) * 1000000 / config->audio_sample_rate);
+                const uint32_t prev_us = atomic_load_explicit(&audio->measured_latency_us, memory_order_relaxed);
+                atomic_store_explicit(&audio->measured_latency_us, 
+                                      prev_us ? (prev_us * 7 + latency_us) / 8 : latency_us, 
+                                      memory_order_relaxed);
+            }
+            tail++;
+        }
+
+        if (!audio->tone_on) {
+            out[i] = 0;
+            continue;
+        }
+
+        // If the current chunk of audio for the square wave is the crest of the wave, 
+        //   this will add the volume, otherwise it is the trough of the wave, and will add
+        //   "negative" volume
+        const uint32_t square_wave_period = config->audio_sample_rate / audio->tone_freq;
+        const uint32_t half_square_wave_period = square_wave_period / 2 ? square_wave_period / 2 : 1;
+        out[i] = ((audio->running_sample_index++ / half_square_wave_period) % 2) ? 
+                        config->volume : 
+                        -config->volume;
+    }
+
+    audio->device_sample += samples;
+    atomic_store_explicit(&audio->tail, tail, memory_order_release);
+}
+
+// Render the audio for the frame just emulated and record whether sound was on
+bool audio_capture_frame(audio_t *audio, audio_capture_t *capture) {
+    // Offline the device clock is the emulated clock, so render up to the next frame start
+    const uint32_t samples = (uint32_t)(audio->frame_sample - audio->device_sample);
+
+    if (capture->frames / 8 >= capture->bits_capacity) {
+        const size_t capacity = capture->bits_capacity ? capture->bits_capacity * 2 : 1024;
+        uint8_t *bits = realloc(capture->sound_bits, capacity);
+        if (!bits) return false;
+        memset(bits + capture->bits_capacity, 0, capacity - capture->bits_capacity);
+        capture->sound_bits = bits;
+        capture->bits_capacity = capacity;
+    }
+    if (audio->frame_sound_on)
+        capture->sound_bits[capture->frames / 8] |= 1 << (capture->frames % 8);
+    capture->frames++;
+
+    if (!capture->keep_pcm) {
+        // Still run the synth so the event ring is drained
+        int16_t scratch[1024];
+        for (uint32_t done = 0; done < samples; ) {
+            const uint32_t n = samples - done < 1024 ? samples - done : 1024;
+            audio_render(audio, scratch, n);
+            done += n;
+        }
+        return true;
+    }
+
+    if (capture->samples + samples > capture->pcm_capacity) {
+        size_t capacity = capture->pcm_capacity ? capture->pcm_capacity * 2 : 65536;
+        while (capacity < capture->samples + samples) capacity *= 2;
+        int16_t *pcm = realloc(capture->pcm, capacity * sizeof *pcm);
+        if (!pcm) return false;
+        capture->pcm = pcm;
+        capture->pcm_capacity = capacity;
+    }
+    audio_render(audio, &capture->pcm[capture->samples], samples);
+    capture->samples += samples;
+    return true;
+}
+
+// Write captured samples as a 16 bit mono PCM WAV file
+bool audio_write_wav(const audio_capture_t *capture, const char *filename, const uint32_t sample_rate) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file %s for writing audio\n", filename);
+        return false;
+    }
+
+    const uint32_t data_size = (uint32_t)(capture->samples * 2);
+    uint8_t header[44];
+    memcpy(&header[0], "RIFF", 4);
+    put_u32(&header[4], 36 + data_size);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    put_u32(&header[16], 16);               // fmt chunk size
+    put_u16(&header[20], 1);                // PCM
+    put_u16(&header[22], 1);                // Mono
+    put_u32(&header[24], sample_rate);
+    put_u32(&header[28], sample_rate * 2);  // Byte rate
+    put_u16(&header[32], 2);                // Block align
+    put_u16(&header[34], 16);               // Bits per sample
+    memcpy(&header[36], "data", 4);
+    put_u32(&header[40], data_size);
+
+    bool ok = fwrite(header, sizeof header, 1, file) == 1;
+    for (size_t i = 0; ok && i < capture->samples; i++) {
+        uint8_t sample[2];
+        put_u16(sample, (uint16_t)capture->pcm[i]);
+        ok = fwrite(sample, sizeof sample, 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed to write audio to file %s\n", filename);
+    return ok;
+}
+
+// Write the per-frame sound bitmap, bit N % 8 of byte N / 8 is frame N
+bool audio_write_sound_bits(const audio_capture_t *capture, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file %s for writing sound bitmap\n", filename);
+        return false;
+    }
+
+    const size_t bytes = (capture->frames + 7) / 8;
+    bool ok = bytes == 0 || fwrite(capture->sound_bits, bytes, 1, file) == 1;
+    if (fclose(file) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed to write sound bitmap to file %s\n", filename);
+    return ok;
+}
+
+void audio_capture_free(audio_capture_t *capture) {
+    free(capture->pcm);
+    free(capture->sound_bits);
+    memset(capture, 0, sizeof *capture);
+}
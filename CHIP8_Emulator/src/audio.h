@@ -0,0 +1,78 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+// CHIP8 beeper: sound events from the emulator and the square wave synth that plays them,
+//   either from the SDL audio callback or offline against emulated time.
+
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+// Sound events pushed from the emulator to the audio callback
+typedef enum {
+    AUDIO_EVENT_OFF,
+    AUDIO_EVENT_ON,
+    AUDIO_EVENT_PITCH,
+} audio_event_type_t;
+
+// Sample-timestamped sound event
+typedef struct {
+    uint64_t sample;            // Emulated sample time the event takes effect at
+    uint64_t host_time;         // monotonic_ns() at push time, to measure latency
+    uint32_t freq;              // New square wave frequency for AUDIO_EVENT_PITCH
+    audio_event_type_t type;
+} audio_event_t;
+
+#define AUDIO_RING_SIZE 256     // Must be a power of 2
+
+// Audio state shared between the emulator (producer) and the audio callback (consumer).
+//   Events go through a single producer/single consumer lock-free ring, so the emulator 
+//   never has to take the SDL audio lock.
+struct audio {
+    audio_event_t events[AUDIO_RING_SIZE];
+    _Atomic uint32_t head;      // Next slot to write, only advanced by the emulator
+    _Atomic uint32_t tail;      // Next slot to read, only advanced by the audio callback
+
+    // Emulator side
+    uint64_t frames;            // Emulated 60hz frames so far
+    uint64_t frame_sample;      // Emulated sample time at the start of the current frame
+    bool sound_on;              // Last on/off state pushed
+    bool frame_sound_on;        // Sound was on at the end of the last emulated frame
+    uint32_t freq;              // Last frequency pushed
+
+    // Audio callback side
+    const config_t *config;
+    bool offline;               // Rendering against emulated time instead of a real device
+    uint64_t device_sample;     // Samples handed to the device so far
+    int64_t clock_offset;       // device_sample - emulated sample, set on the first event/resync
+    bool clock_synced;
+    bool tone_on;               // Square wave currently playing
+    uint32_t tone_freq;         // Frequency of square wave currently playing
+    uint32_t running_sample_index;
+    _Atomic uint32_t measured_latency_us;   // Smoothed event push -> playback latency
+};
+
+// Offline capture of rendered audio for headless runs
+typedef struct {
+    bool keep_pcm;              // Keep rendered samples, otherwise only the sound bitmap is kept
+    int16_t *pcm;               // Rendered mono samples
+    size_t samples;
+    size_t pcm_capacity;
+    uint8_t *sound_bits;        // 1 bit per frame, set if sound was on for that frame
+    size_t frames;
+    size_t bits_capacity;
+} audio_capture_t;
+
+void audio_init(audio_t *audio, const config_t *config, const bool offline);
+bool audio_push_event(audio_t *audio, const audio_event_type_t type, 
+                      const uint32_t freq, const uint32_t sample_offset);
+void audio_set_sound(audio_t *audio, const config_t config, const bool on, const uint32_t sample_offset);
+void audio_end_frame(audio_t *audio, const config_t config);
+void audio_render(audio_t *audio, int16_t *out, const uint32_t samples);
+
+bool audio_capture_frame(audio_t *audio, audio_capture_t *capture);
+bool audio_write_wav(const audio_capture_t *capture, const char *filename, const uint32_t sample_rate);
+bool audio_write_sound_bits(const audio_capture_t *capture, const char *filename);
+void audio_capture_free(audio_capture_t *capture);
+
+#endif // AUDIO_H
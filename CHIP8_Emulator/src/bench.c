@@ -0,0 +1,827 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "chip8.h"
+#include "romlib.h"
+#include "quirkdb.h"
+#include "clone.h"
+#include "rewind.h"
+#include "vecenv.h"
+#ifdef BENCH_SDL
+#include "render.h"
+#endif
+
+// Benchmarks: per opcode microbenchmarks, whole ROM throughput and (with -DBENCH_SDL) 
+//   rendering. Results are written as a flat JSON object of "name.unit": value, where 
+//   ".ns" is lower is better and ".mips" is higher is better, so two runs can be compared.
+
+#define BENCH_BLOCK 64          // Instructions per block, small enough that FX55 never runs I off RAM
+#define BENCH_MIN_NS 50000000   // Run each benchmark for at least 50ms
+#define BENCH_REPEATS 5         // Keep the best of this many runs
+#define MAX_RESULTS 256
+
+typedef struct {
+    char name[128];
+    double value;
+} result_t;
+
+typedef struct {
+    const char *roms_dir;
+    uint64_t rom_frames;
+    uint32_t rom_insts_per_frame;
+    const char *json_file;
+    const char *compare_base;   // Compare mode: baseline and new result files
+    const char *compare_new;
+    double threshold;           // Regression threshold in percent
+    const char *only;           // Run just this group: opcodes, roms, clones, rewind, envs or render
+} bench_opts_t;
+
+static result_t results[MAX_RESULTS];
+static int result_count;
+
+static void add_result(const char *name, const char *unit, const double value) {
+    if (result_count == MAX_RESULTS) return;
+    snprintf(results[result_count].name, sizeof results[0].name, "%s.%s", name, unit);
+    results[result_count++].value = value;
+    printf("%-32s %12.2f %s\n", name, value, unit);
+}
+
+// Opcodes to time, X = 1 and Y = 2 where used. 1NNN jumps to the next instruction.
+static const struct {
+    const char *name;
+    uint16_t opcode;
+} opcode_benches[] = {
+    {"00E0", 0x00E0}, {"1NNN", 0x1000}, {"3XNN", 0x3155}, {"4XNN", 0x4155}, 
+    {"5XY0", 0x5120}, {"6XNN", 0x6155}, {"7XNN", 0x7101}, 
+    {"8XY0", 0x8120}, {"8XY1", 0x8121}, {"8XY2", 0x8122}, {"8XY3", 0x8123}, {"8XY4", 0x8124}, 
+    {"8XY5", 0x8125}, {"8XY6", 0x8126}, {"8XY7", 0x8127}, {"8XYE", 0x812E}, 
+    {"9XY0", 0x9120}, {"ANNN", 0xA300}, {"CXNN", 0xC1FF}, 
+    {"DXYN_1", 0xD121}, {"DXYN_8", 0xD128}, {"DXYN_15", 0xD12F}, 
+    {"EX9E", 0xE19E}, {"FX07", 0xF107}, {"FX15", 0xF115}, {"FX1E", 0xF11E}, {"FX29", 0xF129}, 
+    {"FX33", 0xF133}, {"FX55", 0xFF55}, {"FX65", 0xFF65},
+};
+
+// Nanoseconds per instruction for a block of the same opcode, best of BENCH_REPEATS
+static double bench_opcode(const config_t config, const rom_t *rom, const uint16_t opcode) {
+    static chip8_t chip8;
+    init_chip8(&chip8, config, rom);
+
+    const uint16_t end = CHIP8_ENTRY_POINT + BENCH_BLOCK * 2;
+    for (uint16_t addr = CHIP8_ENTRY_POINT; addr < end; addr += 2) {
+        const uint16_t op = (opcode == 0x1000) ? (0x1000 | (addr + 2)) : opcode;
+        chip8.ram[addr] = op >> 8;
+        chip8.ram[addr + 1] = op & 0xFF;
+    }
+    const uint8_t V[16] = {0x05, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 
+                           0xF0, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD};
+
+    double best = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        uint64_t insts = 0;
+        const uint64_t start = monotonic_ns();
+        uint64_t elapsed;
+
+        do {
+            for (int block = 0; block < 256; block++) {
+                chip8.PC = CHIP8_ENTRY_POINT;
+                chip8.I = 0x600;
+                memcpy(chip8.V, V, sizeof V);
+                while (chip8.PC < end) {
+                    emulate_instruction(&chip8, config);
+                    insts++;
+                }
+            }
+            elapsed = monotonic_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+
+        const double ns = (double)elapsed / insts;
+        if (repeat == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+static void bench_opcodes(const config_t config) {
+    // The benchmark writes its own code over the boot image, it just needs sprite data at I
+    static rom_t rom = {.name = "bench"};
+    for (int i = 0x600; i < 0xA00; i++) 
+        rom.image[i] = i * 37;
+
+    puts("== Opcodes ==");
+    for (size_t i = 0; i < sizeof opcode_benches / sizeof opcode_benches[0]; i++) {
+        char name[32];
+        snprintf(name, sizeof name, "opcode.%s", opcode_benches[i].name);
+        add_result(name, "ns", bench_opcode(config, &rom, opcode_benches[i].opcode));
+    }
+}
+
+// Run every ROM in a directory for a fixed number of frames
+static void bench_roms(const config_t base_config, const bench_opts_t *opts) {
+    DIR *dir = opendir(opts->roms_dir);
+    if (!dir) {
+        fprintf(stderr, "Could not open ROM directory %s\n", opts->roms_dir);
+        return;
+    }
+
+    puts("== ROMs ==");
+    struct dirent *dirent;
+    while ((dirent = readdir(dir))) {
+        if (dirent->d_name[0] == '.') continue;
+
+        char path[FILENAME_MAX];
+        snprintf(path, sizeof path, "%s/%s", opts->roms_dir, dirent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        static rom_t rom;
+        if (!load_rom(&rom, path)) continue;
+
+        config_t config = base_config;
+        quirkdb_apply(&config, &rom);
+        config.insts_per_second = opts->rom_insts_per_frame * 60;
+
+        static chip8_t chip8;
+        init_chip8(&chip8, config, &rom);
+
+        uint64_t insts = 0;
+        const uint64_t start = monotonic_ns();
+        for (uint64_t frame = 0; frame < opts->rom_frames; frame++) 
+            insts += emulate_frame(&chip8, config, NULL);
+        const uint64_t elapsed = monotonic_ns() - start;
+
+        char name[sizeof results[0].name - 8];
+        snprintf(name, sizeof name, "rom.%.100s", dirent->d_name);
+        add_result(name, "mips", elapsed ? insts * 1e3 / elapsed : 0.0);
+    }
+    closedir(dir);
+}
+
+#define CLONE_ROM "TETRIS"
+#define CLONE_WARMUP_FRAMES 300     // Get past the title screen into a game
+#define CLONE_BRANCH_FRAMES 4       // Frames each search branch runs before it's saved
+#define CLONE_CHECK_FRAMES 30       // Frames per branch when checking clones replay right
+
+// Hash of the machine's architectural state, to check clones restore what they saved
+static uint32_t state_hash(const chip8_t *chip8) {
+    static uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    return fnv1a_hash(buf, serialize_state(chip8, buf, sizeof buf));
+}
+
+// Run one search branch: hold key for some frames
+static void run_branch(chip8_t *chip8, const config_t config, const uint8_t key, const uint32_t frames) {
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        memset(chip8->keypad, 0, sizeof chip8->keypad);
+        chip8->keypad[key] = true;
+        emulate_frame(chip8, config, NULL);
+    }
+}
+
+// Branch off each key's clone with the next key, and check every branch comes out the same 
+//   as replaying both keys from boot. Whatever the previous branch wrote to RAM has to be 
+//   undone by the restore.
+static bool check_clones(const config_t config, const rom_t *rom, clone_pool_t *pool) {
+    static chip8_t chip8, check;
+    chip8_clone_t clones[16];
+    bool ok = true;
+
+    init_chip8(&chip8, config, rom);
+    for (uint8_t key = 0; key < 16; key++) {
+        run_branch(&chip8, config, key, CLONE_CHECK_FRAMES);
+        if (!clone_save(pool, &chip8, &clones[key])) {
+            fprintf(stderr, "Clone pool ran out of pages\n");
+            for (uint8_t i = 0; i < key; i++) clone_release(pool, &clones[i]);
+            return false;
+        }
+        if (key == 0) continue;
+
+        // The machine just ran key - 1 then key, go back and run key - 1 then key + 1
+        clone_restore(pool, &chip8, &clones[key - 1]);
+        run_branch(&chip8, config, (key + 1) & 0xF, CLONE_CHECK_FRAMES);
+
+        init_chip8(&check, config, rom);
+        for (uint8_t i = 0; i < key; i++) run_branch(&check, config, i, CLONE_CHECK_FRAMES);
+        run_branch(&check, config, (key + 1) & 0xF, CLONE_CHECK_FRAMES);
+
+        if (state_hash(&chip8) != state_hash(&check)) {
+            fprintf(stderr, "%s: clone branch %X doesn't match a replay from boot\n", rom->name, key);
+            ok = false;
+        }
+        clone_restore(pool, &chip8, &clones[key]);
+    }
+
+    for (uint8_t key = 0; key < 16; key++) clone_release(pool, &clones[key]);
+
+    // A released clone has no pages left to restore from
+    const uint32_t hash = state_hash(&chip8);
+    if (clone_restore(pool, &chip8, &clones[0]) || state_hash(&chip8) != hash) {
+        fprintf(stderr, "%s: restoring a released clone didn't fail cleanly\n", rom->name);
+        ok = false;
+    }
+    return ok;
+}
+
+// Clone save/restore timing on a game in progress, the way a tree search uses them: restore
+//   a node, run a branch, save it as a child. Checks clones on every ROM first, returns 
+//   false if a restored branch doesn't replay the same as running it from boot.
+static bool bench_clones(const config_t base_config, const bench_opts_t *opts) {
+    clone_pool_t pool;
+    if (!clone_pool_init(&pool, 1 << 12)) {
+        fprintf(stderr, "Could not allocate clone pool\n");
+        return false;
+    }
+
+    puts("== Clones ==");
+    bool ok = true;
+    static rom_t rom;
+    DIR *dir = opendir(opts->roms_dir);
+    struct dirent *dirent;
+    while (dir && (dirent = readdir(dir))) {
+        char path[FILENAME_MAX];
+        snprintf(path, sizeof path, "%s/%s", opts->roms_dir, dirent->d_name);
+        struct stat st;
+        if (dirent->d_name[0] == '.' || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (!load_rom(&rom, path)) continue;
+
+        config_t config = base_config;
+        quirkdb_apply(&config, &rom);
+        ok &= check_clones(config, &rom, &pool);
+    }
+    if (dir) closedir(dir);
+
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof path, "%s/%s", opts->roms_dir, CLONE_ROM);
+    if (!ok || !load_rom(&rom, path)) {
+        clone_pool_free(&pool);
+        return false;
+    }
+
+    config_t config = base_config;
+    quirkdb_apply(&config, &rom);
+
+    static chip8_t chip8;
+    init_chip8(&chip8, config, &rom);
+    for (uint32_t frame = 0; frame < CLONE_WARMUP_FRAMES; frame++) 
+        emulate_frame(&chip8, config, NULL);
+
+    chip8_clone_t root, child;
+    clone_save(&pool, &chip8, &root);
+
+    double save_ns = 0, restore_ns = 0, nodes_per_s = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        // Save and restore alone, nothing written in between so every page is shared
+        uint64_t count = 0, start = monotonic_ns(), elapsed;
+        do {
+            for (int i = 0; i < 4096; i++) {
+                clone_save(&pool, &chip8, &child);
+                clone_release(&pool, &child);
+            }
+            count += 4096;
+            elapsed = monotonic_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+        if (repeat == 0 || (double)elapsed / count < save_ns) save_ns = (double)elapsed / count;
+
+        count = 0;
+        start = monotonic_ns();
+        do {
+            for (int i = 0; i < 4096; i++)
+                clone_restore(&pool, &chip8, &root);
+            count += 4096;
+            elapsed = monotonic_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+        if (repeat == 0 || (double)elapsed / count < restore_ns) restore_ns = (double)elapsed / count;
+
+        // Search nodes: restore the root, run a branch, save the child
+        count = 0;
+        start = monotonic_ns();
+        do {
+            for (int i = 0; i < 256; i++) {
+                clone_restore(&pool, &chip8, &root);
+                run_branch(&chip8, config, i & 0xF, CLONE_BRANCH_FRAMES);
+                clone_save(&pool, &chip8, &child);
+                clone_release(&pool, &child);
+            }
+            count += 256;
+            elapsed = monotonic_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+        if (count * 1e9 / elapsed > nodes_per_s) nodes_per_s = count * 1e9 / elapsed;
+    }
+
+    add_result("clone.save", "ns", save_ns);
+    add_result("clone.restore", "ns", restore_ns);
+    add_result("clone.search_nodes", "kps", nodes_per_s / 1e3);
+
+    clone_release(&pool, &root);
+    clone_pool_free(&pool);
+    return true;
+}
+
+#define REWIND_FRAMES 3600          // 1 minute of TETRIS
+#define REWIND_ARENA (4 * 1024 * 1024)  // Same ring as the frontend
+
+// Rewind ring timing: push a snapshot every frame of TETRIS, then step back through all of 
+//   them. Returns false if a step back doesn't restore the frame it was pushed from.
+static bool bench_rewind(const config_t base_config, const bench_opts_t *opts) {
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof path, "%s/%s", opts->roms_dir, CLONE_ROM);
+    static rom_t rom;
+    if (!load_rom(&rom, path)) return false;
+
+    config_t config = base_config;
+    quirkdb_apply(&config, &rom);
+
+    static rewind_t rewind;
+    if (!rewind_init(&rewind, &rom, REWIND_ARENA, REWIND_FRAMES)) {
+        fprintf(stderr, "Could not allocate rewind buffer\n");
+        return false;
+    }
+
+    puts("== Rewind ==");
+    static uint32_t hashes[REWIND_FRAMES];
+    static chip8_t chip8;
+    double push_ns = 0, step_ns = 0, bytes_per_frame = 0;
+    bool ok = true;
+
+    for (int repeat = 0; repeat < BENCH_REPEATS && ok; repeat++) {
+        init_chip8(&chip8, config, &rom);
+        rewind_clear(&rewind);
+
+        // Emulation is timed along with the pushes, then taken off with a second clock
+        uint64_t push_total = 0;
+        for (uint32_t frame = 0; frame < REWIND_FRAMES; frame++) {
+            emulate_frame(&chip8, config, NULL);
+            hashes[frame] = state_hash(&chip8);
+            const uint64_t start = monotonic_ns();
+            rewind_push(&rewind, &chip8);
+            push_total += monotonic_ns() - start;
+        }
+        if (rewind_frames(&rewind) != REWIND_FRAMES) {
+            fprintf(stderr, "Rewind ring dropped frames, holds %llu of %u\n",
+                    (long long unsigned)rewind_frames(&rewind), REWIND_FRAMES);
+            ok = false;
+            break;
+        }
+        const double frame_bytes = (double)rewind.write_pos / REWIND_FRAMES;
+
+        // Every step back has to land on the hash recorded for that frame
+        const uint64_t start = monotonic_ns();
+        for (uint32_t frame = REWIND_FRAMES - 1; frame > 0 && ok; frame--) {
+            if (!rewind_step_back(&rewind, &chip8) || state_hash(&chip8) != hashes[frame - 1]) {
+                fprintf(stderr, "Rewind to frame %u doesn't match the frame pushed\n", frame - 1);
+                ok = false;
+            }
+        }
+        const uint64_t step_total = monotonic_ns() - start;
+        if (ok && rewind_step_back(&rewind, &chip8)) {
+            fprintf(stderr, "Rewound past the oldest frame\n");
+            ok = false;
+        }
+
+        if (repeat == 0 || (double)push_total / REWIND_FRAMES < push_ns) 
+            push_ns = (double)push_total / REWIND_FRAMES;
+        if (repeat == 0 || (double)step_total / (REWIND_FRAMES - 1) < step_ns) 
+            step_ns = (double)step_total / (REWIND_FRAMES - 1);
+        bytes_per_frame = frame_bytes;
+    }
+
+    // After a clear, e.g. a reset or a state load, there's nothing to go back to
+    rewind_push(&rewind, &chip8);
+    rewind_clear(&rewind);
+    if (ok && (rewind_frames(&rewind) != 0 || rewind_step_back(&rewind, &chip8))) {
+        fprintf(stderr, "Rewind ring not empty after a clear\n");
+        ok = false;
+    }
+
+    if (ok) {
+        add_result("rewind.push", "ns", push_ns);
+        add_result("rewind.step_back", "ns", step_ns);
+        add_result("rewind.ring_minutes", "min", bytes_per_frame ? REWIND_ARENA / bytes_per_frame / 3600 : 0.0);
+    }
+    rewind_free(&rewind);
+    return ok;
+}
+
+#define ENV_COUNT 64
+#define ENV_STEPS 600
+#define ENV_MAX_FRAMES 900          // Short episodes, so auto reset is part of the run
+
+// Run ENV_STEPS steps of TETRIS with pseudo random actions, returns a hash of everything 
+//   the environments returned
+static uint32_t run_envs(const config_t config, const rom_t *rom, const uint32_t threads, 
+                         uint64_t *elapsed) {
+    vecenv_options_t options;
+    vecenv_default_options(&options, ENV_COUNT);
+    options.config = config;
+    options.threads = threads;
+    options.max_frames = ENV_MAX_FRAMES;
+
+    vecenv_t env;
+    if (!vecenv_init(&env, &options, rom)) return 0;
+
+    static uint8_t obs[ENV_COUNT * 64*32 / 8];
+    uint16_t actions[ENV_COUNT];
+    float rewards[ENV_COUNT];
+    bool dones[ENV_COUNT];
+    uint32_t hash = 0, dones_seen = 0;
+    uint64_t rng = 1;
+
+    const uint64_t start = monotonic_ns();
+    vecenv_reset(&env, 1, obs);
+    for (uint32_t step = 0; step < ENV_STEPS; step++) {
+        for (uint32_t i = 0; i < ENV_COUNT; i++) {
+            rng = rng * 6364136223846793005ull + 1442695040888963407ull;
+            actions[i] = 1 << (rng >> 60);
+        }
+        vecenv_step(&env, actions, obs, rewards, dones);
+
+        hash = hash * 31 + fnv1a_hash(obs, sizeof obs);
+        for (uint32_t i = 0; i < ENV_COUNT; i++) dones_seen += dones[i];
+    }
+    *elapsed = monotonic_ns() - start;
+
+    vecenv_free(&env);
+    return hash ^ dones_seen;
+}
+
+// Counts frames into V2, one more while key 5 is held, and keeps the count in RAM as BCD
+//   digits at 0x300-0x302 and binary at 0x303, drawing its last hex digit. It never uses
+//   CXNN, so every environment runs exactly like a plain machine booted from the ROM.
+static const uint8_t env_check_rom[] = {
+    0x60, 0x01,     // 200: V0 = 1
+    0xF0, 0x15,     //      delay = V0
+    0xF1, 0x07,     // 204: V1 = delay
+    0x31, 0x00,     //      skip if V1 == 0
+    0x12, 0x04,     //      wait for the next frame
+    0x72, 0x01,     //      V2 += 1
+    0x63, 0x05,     //      V3 = 5
+    0xE3, 0xA1,     //      skip if key 5 isn't held
+    0x72, 0x01,     //      V2 += 1
+    0xA3, 0x00,     //      I = 0x300
+    0xF2, 0x33,     //      BCD of V2 at 0x300
+    0x80, 0x20,     //      V0 = V2
+    0xA3, 0x03,     //      I = 0x303
+    0xF0, 0x55,     //      V0 at 0x303
+    0x00, 0xE0,     //      clear screen
+    0xF2, 0x29,     //      I = font sprite for V2's last digit
+    0x64, 0x08,     //      V4 = 8
+    0xD4, 0x45,     //      draw it at 8, 8
+    0x12, 0x00,     //      again
+};
+
+static int64_t env_score_bcd(const chip8_t *chip8) {
+    return chip8->ram[0x300] * 100 + chip8->ram[0x301] * 10 + chip8->ram[0x302];
+}
+static int64_t env_score_byte(const chip8_t *chip8) {
+    return chip8->ram[0x303];
+}
+static int64_t env_score_word(const chip8_t *chip8) {
+    return (chip8->ram[0x302] << 8) | chip8->ram[0x303];
+}
+
+#define ENV_CHECK_COUNT 4
+#define ENV_CHECK_STEPS 40
+#define ENV_CHECK_OBS (32 * 16)     // Biggest observation, downsampled by 2
+
+// Check scores, rewards, done rules, auto reset and observations against a plain machine
+//   running the same ROM with the same keys
+static bool check_envs(void) {
+    static rom_t rom;
+    load_rom_bytes(&rom, "env check", env_check_rom, sizeof env_check_rom);
+
+    const struct {
+        const char *name;
+        vecenv_reward_t reward;
+        int64_t (*score)(const chip8_t *chip8);
+        vecenv_done_t done;
+        vecenv_obs_t obs_type;
+        uint32_t downsample;
+        bool auto_reset;
+    } cases[] = {
+        {"bcd score", {0x300, 3, true, 1.0f}, env_score_bcd, {0}, VECENV_OBS_PACKED, 2, true},
+        {"sticky done", {0x303, 1, false, -0.5f}, env_score_byte, {0x303, 0x0F, 0x0A},
+         VECENV_OBS_DOWNSAMPLED, 4, false},
+        {"auto reset", {0x302, 2, false, 2.0f}, env_score_word, {0x303, 0x0F, 0x0A},
+         VECENV_OBS_DOWNSAMPLED, 2, true},
+    };
+
+    bool ok = true;
+    for (size_t c = 0; c < sizeof cases / sizeof cases[0] && ok; c++) {
+        vecenv_options_t options;
+        vecenv_default_options(&options, ENV_CHECK_COUNT);
+        options.threads = 2;
+        options.reward = cases[c].reward;
+        options.done = cases[c].done;
+        options.obs_type = cases[c].obs_type;
+        options.downsample = cases[c].downsample;
+        options.auto_reset = cases[c].auto_reset;
+
+        vecenv_t env;
+        if (!vecenv_init(&env, &options, &rom)) return false;
+
+        static chip8_t ref;
+        init_chip8(&ref, env.options.config, &rom);
+        int64_t score = cases[c].score(&ref);
+        bool ref_done = false;
+        uint32_t rewarded = 0, done_count = 0;
+
+        static uint8_t obs[ENV_CHECK_COUNT * ENV_CHECK_OBS];
+        uint8_t want_obs[ENV_CHECK_OBS];
+        uint16_t actions[ENV_CHECK_COUNT];
+        float rewards[ENV_CHECK_COUNT];
+        bool dones[ENV_CHECK_COUNT];
+
+        vecenv_reset(&env, 1, obs);
+        for (uint32_t step = 0; step < ENV_CHECK_STEPS && ok; step++) {
+            const uint16_t action = step % 3 == 0 ? 1 << 5 : 0;
+            for (uint32_t i = 0; i < ENV_CHECK_COUNT; i++) actions[i] = action;
+            vecenv_step(&env, actions, obs, rewards, dones);
+
+            // The same step on the reference machine, a finished episode stays finished
+            float want_reward = 0.0f;
+            if (!ref_done) {
+                for (int key = 0; key < 16; key++) ref.keypad[key] = (action >> key) & 1;
+                for (uint32_t frame = 0; frame < options.frames_per_step; frame++)
+                    emulate_frame(&ref, env.options.config, NULL);
+
+                const int64_t new_score = cases[c].score(&ref);
+                want_reward = cases[c].reward.scale * (float)(new_score - score);
+                score = new_score;
+                ref_done = cases[c].done.mask &&
+                           (ref.ram[cases[c].done.address] & cases[c].done.mask) == cases[c].done.value;
+            }
+            const bool want_done = ref_done;
+            if (ref_done && cases[c].auto_reset) {
+                init_chip8(&ref, env.options.config, &rom);
+                score = cases[c].score(&ref);
+                ref_done = false;
+            }
+
+            // Packed is 1 bit per pixel, downsampled is each cell's share of lit pixels
+            if (cases[c].obs_type == VECENV_OBS_PACKED) {
+                pack_display(ref.display, want_obs);
+            } else {
+                const uint32_t f = cases[c].downsample;
+                for (uint32_t y = 0; y < 32 / f; y++) {
+                    for (uint32_t x = 0; x < 64 / f; x++) {
+                        uint32_t lit = 0;
+                        for (uint32_t p = 0; p < f * f; p++)
+                            lit += ref.display[(y * f + p / f) * 64 + x * f + p % f];
+                        want_obs[y * (64 / f) + x] = lit * 255 / (f * f);
+                    }
+                }
+            }
+
+            rewarded += want_reward != 0.0f;
+            done_count += want_done;
+            for (uint32_t i = 0; i < ENV_CHECK_COUNT && ok; i++) {
+                if (rewards[i] != want_reward || dones[i] != want_done ||
+                    memcmp(&obs[i * env.obs_size], want_obs, env.obs_size) != 0) {
+                    fprintf(stderr, "Environment check %s: env %u step %u got reward %g done %d, "
+                            "expected reward %g done %d%s\n", cases[c].name, i, step, rewards[i],
+                            dones[i], want_reward, want_done,
+                            memcmp(&obs[i * env.obs_size], want_obs, env.obs_size) ? ", obs differ" : "");
+                    ok = false;
+                }
+            }
+        }
+
+        // Make sure the case really had rewards, and episodes ending if it has a done rule
+        if (ok && (rewarded == 0 || (cases[c].done.mask && done_count == 0))) {
+            fprintf(stderr, "Environment check %s never saw a reward or a done episode\n", cases[c].name);
+            ok = false;
+        }
+        vecenv_free(&env);
+    }
+    return ok;
+}
+
+// Vectorized environment steps per second on all cores, after checking the threaded run
+//   returns exactly what a single thread does
+static bool bench_envs(const config_t base_config, const bench_opts_t *opts) {
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof path, "%s/%s", opts->roms_dir, CLONE_ROM);
+    static rom_t rom;
+    if (!load_rom(&rom, path)) return false;
+
+    config_t config = base_config;
+    quirkdb_apply(&config, &rom);
+
+    puts("== Environments ==");
+    if (!check_envs()) return false;
+    uint64_t single_ns, threaded_ns = 0;
+    const uint32_t single = run_envs(config, &rom, 1, &single_ns);
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        // More threads than cores the first time, so the check splits work even on one core
+        uint64_t elapsed;
+        if (run_envs(config, &rom, repeat == 0 ? 4 : 0, &elapsed) != single) {
+            fprintf(stderr, "Threaded environments don't match a single thread\n");
+            return false;
+        }
+        if (repeat == 0 || elapsed < threaded_ns) threaded_ns = elapsed;
+    }
+
+    add_result("env.steps", "kps", threaded_ns ? ENV_COUNT * ENV_STEPS * 1e6 / threaded_ns : 0.0);
+    return true;
+}
+
+static void bench_render(const config_t config) {
+    puts("== Rendering ==");
+
+    // color_lerp over changing colors, so it can't be hoisted out of the loop
+    volatile uint32_t sink = 0;
+    uint64_t calls = 0;
+    const uint64_t start = monotonic_ns();
+    uint64_t elapsed;
+    do {
+        for (uint32_t i = 0; i < 65536; i++) 
+            sink ^= color_lerp(i * 0x9E3779B9u, config.fg_color, config.color_lerp_rate);
+        calls += 65536;
+        elapsed = monotonic_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    add_result("render.color_lerp", "ns", (double)elapsed / calls);
+
+#ifdef BENCH_SDL
+    // update_screen into a hidden window with the software renderer, half the pixels 
+    //   toggling every frame so colors keep lerping
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        SDL_Log("Could not initialize SDL video %s\n", SDL_GetError());
+        return;
+    }
+    sdl_t sdl = {0};
+    sdl.window = SDL_CreateWindow("CHIP8 bench", 0, 0, config.window_width * config.scale_factor,
+                                  config.window_height * config.scale_factor, SDL_WINDOW_HIDDEN);
+    sdl.renderer = sdl.window ? SDL_CreateRenderer(sdl.window, -1, SDL_RENDERER_SOFTWARE) : NULL;
+    if (!sdl.renderer) {
+        SDL_Log("Could not create SDL renderer %s\n", SDL_GetError());
+        SDL_Quit();
+        return;
+    }
+
+    static chip8_t chip8;
+    static rom_t rom = {.name = "bench"};
+    init_chip8(&chip8, config, &rom);
+
+    uint64_t frames = 0;
+    const uint64_t render_start = monotonic_ns();
+    do {
+        for (uint32_t i = 0; i < sizeof chip8.display; i++) 
+            chip8.display[i] = ((i * 7 + frames) & 3) == 0;
+        update_screen(sdl, config, &chip8);
+        frames++;
+        elapsed = monotonic_ns() - render_start;
+    } while (elapsed < BENCH_MIN_NS * 4);
+    add_result("render.update_screen", "ns", (double)elapsed / frames);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+#endif
+}
+
+static bool write_results(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", filename);
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    for (int i = 0; i < result_count; i++) 
+        fprintf(file, "  \"%s\": %.4f%s\n", results[i].name, results[i].value, 
+                i + 1 < result_count ? "," : "");
+    fprintf(file, "}\n");
+
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Read a results file written by write_results, one "name": value per line
+static int read_results(const char *filename, result_t *out) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Could not open results file %s\n", filename);
+        return -1;
+    }
+
+    int count = 0;
+    char line[256];
+    while (count < MAX_RESULTS && fgets(line, sizeof line, file)) 
+        if (sscanf(line, " \"%127[^\"]\": %lf", out[count].name, &out[count].value) == 2) 
+            count++;
+
+    fclose(file);
+    return count;
+}
+
+// Print changes between two result files, returns false if anything got slower than threshold
+static bool compare_results(const bench_opts_t *opts) {
+    static result_t base[MAX_RESULTS], current[MAX_RESULTS];
+    const int base_count = read_results(opts->compare_base, base);
+    const int current_count = read_results(opts->compare_new, current);
+    if (base_count < 0 || current_count < 0) return false;
+
+    int regressions = 0;
+    for (int i = 0; i < current_count; i++) {
+        const result_t *old = NULL;
+        for (int j = 0; j < base_count && !old; j++) 
+            if (strcmp(base[j].name, current[i].name) == 0) old = &base[j];
+        if (!old || old->value == 0) continue;
+
+        // Positive change is better: less time or more instructions per second
+        const bool lower_is_better = strstr(current[i].name, ".ns") != NULL;
+        double change = (current[i].value - old->value) * 100.0 / old->value;
+        if (lower_is_better) change = -change;
+
+        const bool regressed = change < -opts->threshold;
+        regressions += regressed;
+        printf("%-40s %12.2f -> %12.2f  %+7.1f%%%s\n", current[i].name, old->value, 
+               current[i].value, change, regressed ? "  REGRESSION" : "");
+    }
+
+    printf("%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", 
+           opts->threshold);
+    return regressions == 0;
+}
+
+static bool bench_group_known(const char *group) {
+    static const char *groups[] = {"opcodes", "roms", "clones", "rewind", "envs", "render"};
+    for (size_t i = 0; i < sizeof groups / sizeof groups[0]; i++)
+        if (strcmp(group, groups[i]) == 0) return true;
+    return false;
+}
+
+bool set_bench_opts_from_args(bench_opts_t *opts, const int argc, char **argv) {
+    *opts = (bench_opts_t){
+        .roms_dir = "../roms",
+        .rom_frames = 3600,         // 1 minute of emulated time per ROM
+        .rom_insts_per_frame = 1000,    // Far past real speed so emulation dominates
+        .threshold = 10.0,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (strcmp(argv[i], "--roms") == 0) 
+            opts->roms_dir = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0) 
+            opts->rom_frames = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--ipf") == 0) 
+            opts->rom_insts_per_frame = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--json") == 0) 
+            opts->json_file = argv[++i];
+        else if (strcmp(argv[i], "--only") == 0) {
+            opts->only = argv[++i];
+            if (!bench_group_known(opts->only)) {
+                fprintf(stderr, "Unknown group %s for --only\n", opts->only);
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--threshold") == 0) 
+            opts->threshold = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            opts->compare_base = argv[++i];
+            opts->compare_new = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    return true;    // Success
+}
+
+int main(int argc, char **argv) {
+    bench_opts_t opts;
+    if (!set_bench_opts_from_args(&opts, argc, argv)) {
+        fprintf(stderr, "Usage: %s [--roms dir] [--frames N] [--ipf N] [--json out.json]\n"
+                        "       [--only opcodes|roms|clones|rewind|envs|render]\n"
+                        "       %s --compare base.json new.json [--threshold percent]\n", 
+                argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.compare_base) 
+        exit(compare_results(&opts) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    config_t config = {0};
+    char *no_args[] = {argv[0]};
+    if (!set_config_from_args(&config, 1, no_args, NULL)) exit(EXIT_FAILURE);
+
+    bool ok = true;
+    if (!opts.only || strcmp(opts.only, "opcodes") == 0) bench_opcodes(config);
+    if (!opts.only || strcmp(opts.only, "roms") == 0) bench_roms(config, &opts);
+    if (!opts.only || strcmp(opts.only, "clones") == 0) ok = bench_clones(config, &opts);
+    if (!opts.only || strcmp(opts.only, "rewind") == 0) ok &= bench_rewind(config, &opts);
+    if (!opts.only || strcmp(opts.only, "envs") == 0) ok &= bench_envs(config, &opts);
+    if (!opts.only || strcmp(opts.only, "render") == 0) bench_render(config);
+
+    if (opts.json_file && !write_results(opts.json_file)) exit(EXIT_FAILURE);
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -2,124 +2,45 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 
 #include <SDL2/SDL.h>
 
-// SDL Container object
-typedef struct {
-    SDL_Window *window;
-    SDL_Renderer *renderer;
-    SDL_AudioSpec want, have;
-    SDL_AudioDeviceID dev;
-} sdl_t;
-
-// Emulator states
-typedef enum {
-    QUIT,
-    RUNNING,
-    PAUSED,
-} emulator_state_t;
-
-// CHIP-8 extensions/quirks support
-typedef enum {
-    CHIP8,
-    SUPERCHIP,
-    XOCHIP,
-} extension_t;
-
-// Emulator configuration object
-typedef struct {
-    uint32_t window_width;      // SDL window width
-    uint32_t window_height;     // SDL window height
-    uint32_t fg_color;          // Foreground color RGBA8888
-    uint32_t bg_color;          // Background color RGBA8888
-    uint32_t scale_factor;      // Amount to scale a CHIP8 pixel by e.g. 20x will be a 20x larger window
-    bool pixel_outlines;        // Draw pixel "outlines" yes/no
-    uint32_t insts_per_second;  // CHIP8 CPU "clock rate" or hz
-    uint32_t square_wave_freq;  // Frequency of square wave sound e.g. 440hz for middle A
-    uint32_t audio_sample_rate; 
-    int16_t volume;             // How loud or not is the sound
-    float color_lerp_rate;      // Amount to lerp colors by, between [0.1, 1.0]
-    extension_t current_extension;  // Current quirks/extension support for e.g. CHIP8 vs. SUPERCHIP
-} config_t;
-
-// CHIP8 Instruction format
-typedef struct {
-    uint16_t opcode;
-    uint16_t NNN;   // 12 bit address/constant
-    uint8_t NN;     // 8 bit constant
-    uint8_t N;      // 4 bit constant
-    uint8_t X;      // 4 bit register identifier
-    uint8_t Y;      // 4 bit register identifier
-} instruction_t;
-
-// CHIP8 Machine object
-typedef struct {
-    emulator_state_t state;
-    uint8_t ram[4096];
-    bool display[64*32];    // Emulate original CHIP8 resolution pixels
-    uint32_t pixel_color[64*32];    // CHIP8 pixel colors to draw 
-    uint16_t stack[12];     // Subroutine stack
-    uint16_t *stack_ptr;
-    uint8_t V[16];          // Data registers V0-VF
-    uint16_t I;             // Index register
-    uint16_t PC;            // Program Counter
-    uint8_t delay_timer;    // Decrements at 60hz when >0
-    uint8_t sound_timer;    // Decrements at 60hz and plays tone when >0 
-    bool keypad[16];        // Hexadecimal keypad 0x0-0xF
-    const char *rom_name;   // Currently running ROM
-    instruction_t inst;     // Currently executing instruction
-    bool draw;              // Update the screen yes/no
-} chip8_t;
-
-// Color "lerp" helper function
-uint32_t color_lerp(const uint32_t start_color, const uint32_t end_color, const float t) {
-    const uint8_t s_r = (start_color >> 24) & 0xFF;
-    const uint8_t s_g = (start_color >> 16) & 0xFF;
-    const uint8_t s_b = (start_color >>  8) & 0xFF;
-    const uint8_t s_a = (start_color >>  0) & 0xFF;
-
-    const uint8_t e_r = (end_color >> 24) & 0xFF;
-    const uint8_t e_g = (end_color >> 16) & 0xFF;
-    const uint8_t e_b = (end_color >>  8) & 0xFF;
-    const uint8_t e_a = (end_color >>  0) & 0xFF;
-
-    const uint8_t ret_r = ((1-t)*s_r) + (t*e_r);
-    const uint8_t ret_g = ((1-t)*s_g) + (t*e_g);
-    const uint8_t ret_b = ((1-t)*s_b) + (t*e_b);
-    const uint8_t ret_a = ((1-t)*s_a) + (t*e_a);
-
-    return (ret_r << 24) | (ret_g << 16) | (ret_b << 8) | ret_a;
-}
+#include "chip8.h"
+#include "audio.h"
+#include "rewind.h"
+#include "save_writer.h"
+#include "romlib.h"
+#include "quirkdb.h"
+#include "movie.h"
+#include "telemetry.h"
+#include "debugger.h"
+#include "perfcount.h"
+#include "analysis.h"
+#include "render.h"
+#ifdef PROFILE
+#include "profile.h"
+#endif
+#ifdef TRACE
+#include "trace.h"
+#endif
 
 // SDL Audio callback
 // Fill out stream/audio buffer with data
 void audio_callback(void *userdata, uint8_t *stream, int len) {
-    config_t *config = (config_t *)userdata;
-
-    int16_t *audio_data = (int16_t *)stream;
-    static uint32_t running_sample_index = 0;
-    const int32_t square_wave_period = config->audio_sample_rate / config->square_wave_freq;
-    const int32_t half_square_wave_period = square_wave_period / 2;
-
-    // We are filling out 2 bytes at a time (int16_t), len is in bytes,
-    //   so divide by 2
-    // If the current chunk of audio for the square wave is the crest of the wave, 
-    //   this will add the volume, otherwise it is the trough of the wave, and will add
-    //   "negative" volume
-    for (int i = 0; i < len / 2; i++)
-        audio_data[i] = ((running_sample_index++ / half_square_wave_period) % 2) ? 
-                        config->volume : 
-                        -config->volume;
+    // We are filling out 2 bytes at a time (int16_t), len is in bytes, so divide by 2
+    audio_render((audio_t *)userdata, (int16_t *)stream, len / 2);
 }
 
-// Initialize SDL
-bool init_sdl(sdl_t *sdl, config_t *config) {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0) {
+// Initialize SDL video, a window and renderer, or just events with --headless. Audio is 
+//   left for init_audio, once we know the ROM needs it.
+bool init_video(sdl_t *sdl, const config_t *config) {
+    if (SDL_InitSubSystem(config->headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) != 0) {
         SDL_Log("Could not initialize SDL subsystems! %s\n", SDL_GetError());
         return false;
     }
+    if (config->headless) return true;
 
     sdl->window = SDL_CreateWindow("CHIP8 Emulator", SDL_WINDOWPOS_CENTERED, 
                                    SDL_WINDOWPOS_CENTERED, 
@@ -131,20 +52,38 @@ bool init_sdl(sdl_t *sdl, config_t *config) {
         return false;
     }
 
-    sdl->renderer = SDL_CreateRenderer(sdl->window, -1, SDL_RENDERER_ACCELERATED);
+    // A named render driver, e.g. "software" where there's no GPU, else SDL's choice
+    uint32_t flags = SDL_RENDERER_ACCELERATED;
+    if (config->renderer) {
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, config->renderer);
+        if (strcmp(config->renderer, "software") == 0) flags = SDL_RENDERER_SOFTWARE;
+    }
+    if (config->vsync) flags |= SDL_RENDERER_PRESENTVSYNC;
+
+    sdl->renderer = SDL_CreateRenderer(sdl->window, -1, flags);
     if (!sdl->renderer) {
         SDL_Log("Could not create SDL renderer %s\n", SDL_GetError());
         return false;
     }
 
-    // Init Audio stuff
+    return true;    // Success
+}
+
+// Initialize SDL audio and open the audio device
+bool init_audio(sdl_t *sdl, config_t *config, audio_t *audio) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        SDL_Log("Could not initialize SDL audio! %s\n", SDL_GetError());
+        return false;
+    }
+
+    audio_init(audio, config, false);
     sdl->want = (SDL_AudioSpec){
-        .freq = 44100,          // 44100hz "CD" quality
-        .format = AUDIO_S16LSB, // Signed 16 bit little endian
-        .channels = 1,          // Mono, 1 channel
-        .samples = 512,
+        .freq = config->audio_sample_rate,  // 44100hz "CD" quality by default
+        .format = AUDIO_S16LSB,             // Signed 16 bit little endian
+        .channels = 1,                      // Mono, 1 channel
+        .samples = config->audio_buffer_samples,
         .callback = audio_callback,
-        .userdata = config,        // Userdata passed to audio callback
+        .userdata = audio,                  // Userdata passed to audio callback
     };
 
     sdl->dev = SDL_OpenAudioDevice(NULL, 0, &sdl->want, &sdl->have, 0);
@@ -161,237 +100,95 @@ bool init_sdl(sdl_t *sdl, config_t *config) {
         return false;
     }
 
-    return true;    // Success
-}
-
-// Set up initial emulator configuration from passed in arguments
-bool set_config_from_args(config_t *config, const int argc, char **argv) {
-
-    // Set defaults
-    *config = (config_t){
-        .window_width  = 64,    // CHIP8 original X resolution
-        .window_height = 32,    // CHIP8 original Y resolution
-        .fg_color = 0xFFFFFFFF, // WHITE
-        .bg_color = 0x000000FF, // BLACK
-        .scale_factor = 20,     // Default resolution will be 1280x640
-        .pixel_outlines = true, // Draw pixel "outlines" by default
-        .insts_per_second = 600, // Number of instructions to emulate in 1 second (clock rate of CPU)
-        .square_wave_freq = 440,    // 440hz for middle A
-        .audio_sample_rate = 44100, // CD quality, 44100hz
-        .volume = 3000,             // INT16_MAX would be max volume
-        .color_lerp_rate = 0.7,     // Color lerp rate, between [0.1, 1.0]
-        .current_extension = CHIP8, // Set default quirks/extension to plain OG CHIP-8
-    };
-
-    // Override defaults from passed in arguments
-    for (int i = 1; i < argc; i++) {
-            (void)argv[i];  // Prevent compiler error from unused variables argc/argv
-            // e.g. set scale factor
-            if (strncmp(argv[i], "--scale-factor", strlen("--scale-factor")) == 0) {
-                // Note: should probably add checks for numeric
-                i++;
-                config->scale_factor = (uint32_t)strtol(argv[i], NULL, 10);
-            }
-    }
+    // The device plays continuously, sound on/off is driven by events from the emulator
+    config->audio_sample_rate = sdl->have.freq;
+    SDL_PauseAudioDevice(sdl->dev, 0);
 
     return true;    // Success
 }
 
-// Initialize CHIP8 machine
-bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]) {
-    const uint32_t entry_point = 0x200; // CHIP8 Roms will be loaded to 0x200
-    const uint8_t font[] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0,   // 0   
-        0x20, 0x60, 0x20, 0x20, 0x70,   // 1  
-        0xF0, 0x10, 0xF0, 0x80, 0xF0,   // 2 
-        0xF0, 0x10, 0xF0, 0x10, 0xF0,   // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10,   // 4    
-        0xF0, 0x80, 0xF0, 0x10, 0xF0,   // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0,   // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40,   // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0,   // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0,   // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90,   // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0,   // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0,   // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0,   // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0,   // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80,   // F
-    };
-
-    // Initialize entire CHIP8 machine
-    memset(chip8, 0, sizeof(chip8_t));
-
-    // Load font 
-    memcpy(&chip8->ram[0], font, sizeof(font));
-   
-    // Open ROM file
-    FILE *rom = fopen(rom_name, "rb");
-    if (!rom) {
-        SDL_Log("Rom file %s is invalid or does not exist\n", rom_name);
-        return false;
-    }
-
-    // Get/check rom size
-    fseek(rom, 0, SEEK_END);
-    const size_t rom_size = ftell(rom);
-    const size_t max_size = sizeof chip8->ram - entry_point;
-    rewind(rom);
-
-    if (rom_size > max_size) {
-        SDL_Log("Rom file %s is too big! Rom size: %llu, Max size allowed: %llu\n", 
-                rom_name, (long long unsigned)rom_size, (long long unsigned)max_size);
-        return false;
-    }
-
-    // Load ROM
-    if (fread(&chip8->ram[entry_point], rom_size, 1, rom) != 1) {
-        SDL_Log("Could not read Rom file %s into CHIP8 memory\n", 
-                rom_name);
-        return false;
+// ROM loading, quirk lookup and analysis, run on its own thread while the window is created
+typedef struct {
+    config_t config;        // Copy of the emulator config, the quirk database is applied to it
+    const char *rom_name;
+    rom_library_t roms;
+    const rom_t *rom;       // NULL if it didn't load
+    bool known;             // In the quirk database
+    bool may_use_sound;     // Can reach an FX18, or analysis couldn't tell
+    uint64_t ticks;         // Performance counter ticks it took
+} rom_loader_t;
+
+int rom_loader_thread(void *data) {
+    rom_loader_t *loader = data;
+    const uint64_t start = SDL_GetPerformanceCounter();
+
+    if (romlib_open(&loader->roms, loader->config.rom_index)) 
+        loader->rom = romlib_load(&loader->roms, loader->rom_name);
+    if (loader->rom) {
+        loader->known = quirkdb_apply(&loader->config, loader->rom);
+        const analysis_t *analysis = analysis_get(loader->rom, loader->config.current_extension);
+        loader->may_use_sound = analysis_may_use_sound(analysis, loader->rom);
     }
-    fclose(rom);
 
-    // Set chip8 machine defaults
-    chip8->state = RUNNING;     // Default machine state to on/running
-    chip8->PC = entry_point;    // Start program counter at ROM entry point
-    chip8->rom_name = rom_name;
-    chip8->stack_ptr = &chip8->stack[0];
-    memset(&chip8->pixel_color[0], config.bg_color, sizeof chip8->pixel_color); // Init pixels to bg color
+    loader->ticks = SDL_GetPerformanceCounter() - start;
+    return 0;
+}
 
-    return true;    // Success
+// Performance counter ticks in milliseconds
+static double ticks_ms(const uint64_t ticks) {
+    return (double)ticks * 1000.0 / SDL_GetPerformanceFrequency();
 }
 
 // Final cleanup
 void final_cleanup(const sdl_t sdl) {
-    SDL_DestroyRenderer(sdl.renderer);
-    SDL_DestroyWindow(sdl.window);
-    SDL_CloseAudioDevice(sdl.dev);
+    if (sdl.renderer) SDL_DestroyRenderer(sdl.renderer);
+    if (sdl.window) SDL_DestroyWindow(sdl.window);
+    if (sdl.dev) SDL_CloseAudioDevice(sdl.dev);
     SDL_Quit(); // Shut down SDL subsystem
 }
 
-// Clear screen / SDL Window to background color
-void clear_screen(const sdl_t sdl, const config_t config) {
-    const uint8_t r = (config.bg_color >> 24) & 0xFF;
-    const uint8_t g = (config.bg_color >> 16) & 0xFF;
-    const uint8_t b = (config.bg_color >>  8) & 0xFF;
-    const uint8_t a = (config.bg_color >>  0) & 0xFF;
+// Finish the movie being recorded and write it out. Called at exit, and before loading a 
+//   state, resetting or rewinding, since the recorded input only replays from boot.
+void stop_recording(movie_t *movie, const chip8_t *chip8, const config_t config) {
+    if (!movie->recording) return;
 
-    SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
-    SDL_RenderClear(sdl.renderer);
+    movie_finish(movie, chip8);
+    if (movie_save(movie, config.record_movie)) 
+        printf("Recorded %u frames to %s\n", movie->frames, config.record_movie);
+    else 
+        printf("Failed to write movie %s\n", config.record_movie);
 }
 
-// Update window with any changes
-void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8) {
-    SDL_Rect rect = {.x = 0, .y = 0, .w = config.scale_factor, .h = config.scale_factor};
-
-    // Grab bg color values to draw outlines
-    const uint8_t bg_r = (config.bg_color >> 24) & 0xFF;
-    const uint8_t bg_g = (config.bg_color >> 16) & 0xFF;
-    const uint8_t bg_b = (config.bg_color >>  8) & 0xFF;
-    const uint8_t bg_a = (config.bg_color >>  0) & 0xFF;
-
-    // Loop through display pixels, draw a rectangle per pixel to the SDL window
-    for (uint32_t i = 0; i < sizeof chip8->display; i++) {
-        // Translate 1D index i value to 2D X/Y coordinates
-        // X = i % window width
-        // Y = i / window width
-        rect.x = (i % config.window_width) * config.scale_factor;
-        rect.y = (i / config.window_width) * config.scale_factor;
-
-        if (chip8->display[i]) {
-            // Pixel is on, draw foreground color
-            if (chip8->pixel_color[i] != config.fg_color) {
-                // Lerp towards fg_color
-                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i], 
-                                                   config.fg_color, 
-                                                   config.color_lerp_rate);
-            }
-
-            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
-            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
-            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
-            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
-
-            SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
-            SDL_RenderFillRect(sdl.renderer, &rect);
-        
-            // TODO: Move this outside if/else, and combine lerping or at least reduce duplicate code
-            if (config.pixel_outlines) {
-                // If user requested drawing pixel outlines, draw those here
-                SDL_SetRenderDrawColor(sdl.renderer, bg_r, bg_g, bg_b, bg_a);
-                SDL_RenderDrawRect(sdl.renderer, &rect);
-            }
-
-        } else {
-            // Pixel is off, draw background color
-            if (chip8->pixel_color[i] != config.bg_color) {
-                // Lerp towards bg_color
-                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i], 
-                                                   config.bg_color, 
-                                                   config.color_lerp_rate);
-            }
-
-            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
-            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
-            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
-            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
-
-            SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
-            SDL_RenderFillRect(sdl.renderer, &rect);
-        }
+// CHIP8 keypad keys for the arrow keys in each layout: left, right, up, down
+static const int8_t arrow_keys[][4] = {
+    [KEYPAD_QWERTY]        = {-1, -1, -1, -1},
+    [KEYPAD_ARROWS_2468]   = {0x4, 0x6, 0x2, 0x8},
+    [KEYPAD_ARROWS_TETRIS] = {0x5, 0x6, 0x4, 0x7},
+};
+
+// Press/release the CHIP8 key an arrow key is mapped to, if any
+void set_arrow_key(chip8_t *chip8, const config_t config, const SDL_Keycode key, const bool down) {
+    int arrow;
+    switch (key) {
+        case SDLK_LEFT:  arrow = 0; break;
+        case SDLK_RIGHT: arrow = 1; break;
+        case SDLK_UP:    arrow = 2; break;
+        case SDLK_DOWN:  arrow = 3; break;
+        default: return;
     }
-
-    SDL_RenderPresent(sdl.renderer);
-}
-
-
-// Save Chip8 state to file
-bool save_state(const chip8_t *chip8, const char *filename) {
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        SDL_Log("Failed to open file %s for saving state\n", filename);
-        return false;
-    }
-
-    // Write the entire chip8_t structure to the file
-    if (fwrite(chip8, sizeof(chip8_t), 1, file) != 1) {
-        SDL_Log("Failed to write state to file %s\n", filename);
-        fclose(file);
-        return false;
-    }
-
-    fclose(file);
-    return true;
+    const int8_t chip8_key = arrow_keys[config.keypad_layout][arrow];
+    if (chip8_key >= 0) chip8->keypad[chip8_key] = down;
 }
 
-// Load Chip8 state from file
-bool load_state(chip8_t *chip8, const char *filename) {
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        SDL_Log("Failed to open file %s for loading state\n", filename);
-        return false;
-    }
-
-    // Read the entire chip8_t structure from the file
-    if (fread(chip8, sizeof(chip8_t), 1, file) != 1) {
-        SDL_Log("Failed to read state from file %s\n", filename);
-        fclose(file);
-        return false;
-    }
-
-    fclose(file);
-    return true;
-}
-
-// Handle user input
 // CHIP8 Keypad  QWERTY 
 // 123C          1234
 // 456D          qwer
 // 789E          asdf
 // A0BF          zxcv
-void handle_input(chip8_t *chip8, config_t *config) {
+void handle_input(chip8_t *chip8, config_t *config, save_writer_t *writer, movie_t *movie, rewind_t *rewind) {
     SDL_Event event;
+    char save_file[32];
+    snprintf(save_file, sizeof save_file, "save_state_%u.bin", config->save_slot);
 
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
@@ -419,7 +216,9 @@ void handle_input(chip8_t *chip8, config_t *config) {
 
                     case SDLK_EQUALS:
                         // '=': Reset CHIP8 machine for the current ROM
-                        init_chip8(chip8, *config, chip8->rom_name);
+                        stop_recording(movie, chip8, *config);
+                        init_chip8(chip8, *config, chip8->rom);
+                        rewind_clear(rewind);   // Don't rewind into the run before the reset
                         break;
 
                     case SDLK_j:
@@ -446,24 +245,61 @@ void handle_input(chip8_t *chip8, config_t *config) {
                             config->volume += 500;
                         break;
 
-                    // Save state on F5
+                    // Save state on F5, the file is written in the background
                     case SDLK_F5:
-                        if (save_state(chip8, "save_state.bin")) {
-                            puts("State saved successfully.");
-                        } else {
+                        if (!save_writer_submit(writer, chip8, save_file)) 
                             puts("Failed to save state.");
-                        }
+                        break;
+
+                    // Toggle frame timing overlay on F3
+                    case SDLK_F3:
+                        config->stats_overlay = !config->stats_overlay;
+                        break;
+
+                    // Select save slot on F6/F7
+                    case SDLK_F6:
+                        config->save_slot = (config->save_slot + 9) % 10;
+                        printf("Save slot %u\n", config->save_slot);
+                        break;
+
+                    case SDLK_F7:
+                        config->save_slot = (config->save_slot + 1) % 10;
+                        printf("Save slot %u\n", config->save_slot);
                         break;
 
                     // Load state on F9
                     case SDLK_F9:
-                        if (load_state(chip8, "save_state.bin")) {
+                        stop_recording(movie, chip8, *config);
+                        if (load_state(chip8, save_file)) {
+                            rewind_clear(rewind);
                             puts("State loaded successfully.");
                         } else {
                             puts("Failed to load state.");
                         }
                         break;
 
+                    // Single step a paused machine on F10
+                    case SDLK_F10:
+                        if (chip8->state == PAUSED) {
+                            debugger_step(config->debugger, chip8, *config);
+                            debugger_report(config->debugger, chip8);
+                        }
+                        break;
+
+#ifdef TRACE
+                    // Dump the instruction trace on F8, decode it with tracedump
+                    case SDLK_F8:
+                        if (trace_dump(config->trace, config->trace_file, TRACE_SIZE)) 
+                            printf("Instruction trace written to %s\n", config->trace_file);
+                        break;
+#endif
+
+                    // Rewind while backspace is held
+                    case SDLK_BACKSPACE:
+                        if (chip8->state == RUNNING) 
+                            chip8->state = REWINDING;
+                        break;
+
                     // Map qwerty keys to CHIP8 keypad
                     case SDLK_1: chip8->keypad[0x1] = true; break;
                     case SDLK_2: chip8->keypad[0x2] = true; break;
@@ -485,6 +321,11 @@ void handle_input(chip8_t *chip8, config_t *config) {
                     case SDLK_c: chip8->keypad[0xB] = true; break;
                     case SDLK_v: chip8->keypad[0xF] = true; break;
 
+                    // Arrow keys, depending on the ROM's keypad layout
+                    case SDLK_LEFT: case SDLK_RIGHT: case SDLK_UP: case SDLK_DOWN:
+                        set_arrow_key(chip8, *config, event.key.keysym.sym, true);
+                        break;
+
                     default: break;
                         
                 }
@@ -492,6 +333,12 @@ void handle_input(chip8_t *chip8, config_t *config) {
 
             case SDL_KEYUP:
                 switch (event.key.keysym.sym) {
+                    case SDLK_BACKSPACE:
+                        // Stop rewinding and resume from the current frame
+                        if (chip8->state == REWINDING) 
+                            chip8->state = RUNNING;
+                        break;
+
                     // Map qwerty keys to CHIP8 keypad
                     case SDLK_1: chip8->keypad[0x1] = false; break;
                     case SDLK_2: chip8->keypad[0x2] = false; break;
@@ -513,6 +360,10 @@ void handle_input(chip8_t *chip8, config_t *config) {
                     case SDLK_c: chip8->keypad[0xB] = false; break;
                     case SDLK_v: chip8->keypad[0xF] = false; break;
 
+                    case SDLK_LEFT: case SDLK_RIGHT: case SDLK_UP: case SDLK_DOWN:
+                        set_arrow_key(chip8, *config, event.key.keysym.sym, false);
+                        break;
+
                     default: break;
                 }
                 break;
@@ -523,675 +374,147 @@ void handle_input(chip8_t *chip8, config_t *config) {
     }
 }
 
-#ifdef DEBUG
-void print_debug_info(chip8_t *chip8) {
-    printf("Address: 0x%04X, Opcode: 0x%04X Desc: ",
-           chip8->PC-2, chip8->inst.opcode);
-
-    switch ((chip8->inst.opcode >> 12) & 0x0F) {
-        case 0x00:
-            if (chip8->inst.NN == 0xE0) {
-                // 0x00E0: Clear the screen
-                printf("Clear screen\n");
-
-            } else if (chip8->inst.NN == 0xEE) {
-                // 0x00EE: Return from subroutine
-                // Set program counter to last address on subroutine stack ("pop" it off the stack)
-                //   so that next opcode will be gotten from that address.
-                printf("Return from subroutine to address 0x%04X\n",
-                       *(chip8->stack_ptr - 1));
-            } else {
-                printf("Unimplemented Opcode.\n");
-            }
-            break;
-
-        case 0x01:
-            // 0x1NNN: Jump to address NNN
-            printf("Jump to address NNN (0x%04X)\n",
-                   chip8->inst.NNN);   
-            break;
-
-        case 0x02:
-            // 0x2NNN: Call subroutine at NNN
-            // Store current address to return to on subroutine stack ("push" it on the stack)
-            //   and set program counter to subroutine address so that the next opcode
-            //   is gotten from there.
-            printf("Call subroutine at NNN (0x%04X)\n",
-                   chip8->inst.NNN);
-            break;
-
-        case 0x03:
-            // 0x3XNN: Check if VX == NN, if so, skip the next instruction
-            printf("Check if V%X (0x%02X) == NN (0x%02X), skip next instruction if true\n",
-                   chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN);
-            break;
-
-        case 0x04:
-            // 0x4XNN: Check if VX != NN, if so, skip the next instruction
-            printf("Check if V%X (0x%02X) != NN (0x%02X), skip next instruction if true\n",
-                   chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN);
-            break;
-
-        case 0x05:
-            // 0x5XY0: Check if VX == VY, if so, skip the next instruction
-            printf("Check if V%X (0x%02X) == V%X (0x%02X), skip next instruction if true\n",
-                   chip8->inst.X, chip8->V[chip8->inst.X], 
-                   chip8->inst.Y, chip8->V[chip8->inst.Y]);
-            break;
-
-        case 0x06:
-            // 0x6XNN: Set register VX to NN
-            printf("Set register V%X = NN (0x%02X)\n",
-                   chip8->inst.X, chip8->inst.NN);
-            break;
-
-        case 0x07:
-            // 0x7XNN: Set register VX += NN
-            printf("Set register V%X (0x%02X) += NN (0x%02X). Result: 0x%02X\n",
-                   chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.NN,
-                   chip8->V[chip8->inst.X] + chip8->inst.NN);
-            break;
-
-        case 0x08:
-            switch(chip8->inst.N) {
-                case 0:
-                    // 0x8XY0: Set register VX = VY
-                    printf("Set register V%X = V%X (0x%02X)\n",
-                           chip8->inst.X, chip8->inst.Y, chip8->V[chip8->inst.Y]);
-                    break;
-
-                case 1:
-                    // 0x8XY1: Set register VX |= VY
-                    printf("Set register V%X (0x%02X) |= V%X (0x%02X); Result: 0x%02X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->V[chip8->inst.X] | chip8->V[chip8->inst.Y]);
-                    break;
-
-                case 2:
-                    // 0x8XY2: Set register VX &= VY
-                    printf("Set register V%X (0x%02X) &= V%X (0x%02X); Result: 0x%02X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->V[chip8->inst.X] & chip8->V[chip8->inst.Y]);
-                    break;
-
-                case 3:
-                    // 0x8XY3: Set register VX ^= VY
-                    printf("Set register V%X (0x%02X) ^= V%X (0x%02X); Result: 0x%02X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->V[chip8->inst.X] ^ chip8->V[chip8->inst.Y]);
-                    break;
-
-                case 4:
-                    // 0x8XY4: Set register VX += VY, set VF to 1 if carry
-                    printf("Set register V%X (0x%02X) += V%X (0x%02X), VF = 1 if carry; Result: 0x%02X, VF = %X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y],
-                           ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255));
-                    break;
-
-                case 5:
-                    // 0x8XY5: Set register VX -= VY, set VF to 1 if there is not a borrow (result is positive/0)
-                    printf("Set register V%X (0x%02X) -= V%X (0x%02X), VF = 1 if no borrow; Result: 0x%02X, VF = %X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->V[chip8->inst.X] - chip8->V[chip8->inst.Y],
-                           (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]));
-                    break;
-
-                case 6:
-                    // 0x8XY6: Set register VX >>= 1, store shifted off bit in VF
-                    printf("Set register V%X (0x%02X) >>= 1, VF = shifted off bit (%X); Result: 0x%02X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->V[chip8->inst.X] & 1,
-                           chip8->V[chip8->inst.X] >> 1);
-                    break;
-
-                case 7:
-                    // 0x8XY7: Set register VX = VY - VX, set VF to 1 if there is not a borrow (result is positive/0)
-                    printf("Set register V%X = V%X (0x%02X) - V%X (0x%02X), VF = 1 if no borrow; Result: 0x%02X, VF = %X\n",
-                           chip8->inst.X, chip8->inst.Y, chip8->V[chip8->inst.Y],
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X],
-                           (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]));
-                    break;
-
-                case 0xE:
-                    // 0x8XYE: Set register VX <<= 1, store shifted off bit in VF
-                    printf("Set register V%X (0x%02X) <<= 1, VF = shifted off bit (%X); Result: 0x%02X\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X],
-                           (chip8->V[chip8->inst.X] & 0x80) >> 7,
-                           chip8->V[chip8->inst.X] << 1);
-                    break;
-
-                default:
-                    // Wrong/unimplemented opcode
-                    break;
-            }
-            break;
-
-        case 0x09:
-            // 0x9XY0: Check if VX != VY; Skip next instruction if so
-            printf("Check if V%X (0x%02X) != V%X (0x%02X), skip next instruction if true\n",
-                   chip8->inst.X, chip8->V[chip8->inst.X], 
-                   chip8->inst.Y, chip8->V[chip8->inst.Y]);
-            break;
-
-        case 0x0A:
-            // 0xANNN: Set index register I to NNN
-            printf("Set I to NNN (0x%04X)\n",
-                   chip8->inst.NNN);
-            break;
-
-        case 0x0B:
-            // 0xBNNN: Jump to V0 + NNN
-            printf("Set PC to V0 (0x%02X) + NNN (0x%04X); Result PC = 0x%04X\n",
-                   chip8->V[0], chip8->inst.NNN, chip8->V[0] + chip8->inst.NNN);
-            break;
-
-        case 0x0C:
-            // 0xCXNN: Sets register VX = rand() % 256 & NN (bitwise AND)
-            printf("Set V%X = rand() %% 256 & NN (0x%02X)\n",
-                   chip8->inst.X, chip8->inst.NN);
-            break;
-
-        case 0x0D:
-            // 0xDXYN: Draw N-height sprite at coords X,Y; Read from memory location I;
-            //   Screen pixels are XOR'd with sprite bits, 
-            //   VF (Carry flag) is set if any screen pixels are set off; This is useful
-            //   for collision detection or other reasons.
-            printf("Draw N (%u) height sprite at coords V%X (0x%02X), V%X (0x%02X) "
-                   "from memory location I (0x%04X). Set VF = 1 if any pixels are turned off.\n",
-                   chip8->inst.N, chip8->inst.X, chip8->V[chip8->inst.X], chip8->inst.Y,
-                   chip8->V[chip8->inst.Y], chip8->I);
-            break;
-
-        case 0x0E:
-            if (chip8->inst.NN == 0x9E) {
-                // 0xEX9E: Skip next instruction if key in VX is pressed
-                printf("Skip next instruction if key in V%X (0x%02X) is pressed; Keypad value: %d\n",
-                       chip8->inst.X, chip8->V[chip8->inst.X], chip8->keypad[chip8->V[chip8->inst.X]]);
-
-            } else if (chip8->inst.NN == 0xA1) {
-                // 0xEX9E: Skip next instruction if key in VX is not pressed
-                printf("Skip next instruction if key in V%X (0x%02X) is not pressed; Keypad value: %d\n",
-                       chip8->inst.X, chip8->V[chip8->inst.X], chip8->keypad[chip8->V[chip8->inst.X]]);
-            }
-            break;
-
-        case 0x0F:
-            switch (chip8->inst.NN) {
-                case 0x0A:
-                    // 0xFX0A: VX = get_key(); Await until a keypress, and store in VX
-                    printf("Await until a key is pressed; Store key in V%X\n",
-                           chip8->inst.X);
-                    break;
-
-                case 0x1E:
-                    // 0xFX1E: I += VX; Add VX to register I. For non-Amiga CHIP8, does not affect VF
-                    printf("I (0x%04X) += V%X (0x%02X); Result (I): 0x%04X\n",
-                           chip8->I, chip8->inst.X, chip8->V[chip8->inst.X],
-                           chip8->I + chip8->V[chip8->inst.X]);
-                    break;
-
-                case 0x07:
-                    // 0xFX07: VX = delay timer
-                    printf("Set V%X = delay timer value (0x%02X)\n",
-                           chip8->inst.X, chip8->delay_timer);
-                    break;
-
-                case 0x15:
-                    // 0xFX15: delay timer = VX 
-                    printf("Set delay timer value = V%X (0x%02X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X]);
-                    break;
-
-                case 0x18:
-                    // 0xFX18: sound timer = VX 
-                    printf("Set sound timer value = V%X (0x%02X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X]);
-                    break;
-
-                case 0x29:
-                    // 0xFX29: Set register I to sprite location in memory for character in VX (0x0-0xF)
-                    printf("Set I to sprite location in memory for character in V%X (0x%02X). Result(VX*5) = (0x%02X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X], chip8->V[chip8->inst.X] * 5);
-                    break;
-
-                case 0x33:
-                    // 0xFX33: Store BCD representation of VX at memory offset from I;
-                    //   I = hundred's place, I+1 = ten's place, I+2 = one's place
-                    printf("Store BCD representation of V%X (0x%02X) at memory from I (0x%04X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X], chip8->I);
-                    break;
-
-                case 0x55:
-                    // 0xFX55: Register dump V0-VX inclusive to memory offset from I;
-                    //   SCHIP does not inrement I, CHIP8 does increment I
-                    printf("Register dump V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X], chip8->I);
-                    break;
-
-                case 0x65:
-                    // 0xFX65: Register load V0-VX inclusive from memory offset from I;
-                    //   SCHIP does not inrement I, CHIP8 does increment I
-                    printf("Register load V0-V%X (0x%02X) inclusive at memory from I (0x%04X)\n",
-                           chip8->inst.X, chip8->V[chip8->inst.X], chip8->I);
-                    break;
-
-                default:
-                    break;
-            }
-            break;
-            
-        default:
-            printf("Unimplemented Opcode.\n");
-            break;  // Unimplemented or invalid opcode
-    }
-}
-#endif
-
-// Emulate 1 CHIP8 instruction
-void emulate_instruction(chip8_t *chip8, const config_t config) {
-    bool carry;   // Save carry flag/VF value for some instructions
-
-    // Get next opcode from ram 
-    chip8->inst.opcode = (chip8->ram[chip8->PC] << 8) | chip8->ram[chip8->PC+1];
-    chip8->PC += 2; // Pre-increment program counter for next opcode
-
-    // Fill out current instruction format
-    chip8->inst.NNN = chip8->inst.opcode & 0x0FFF;
-    chip8->inst.NN = chip8->inst.opcode & 0x0FF;
-    chip8->inst.N = chip8->inst.opcode & 0x0F;
-    chip8->inst.X = (chip8->inst.opcode >> 8) & 0x0F;
-    chip8->inst.Y = (chip8->inst.opcode >> 4) & 0x0F;
-
-#ifdef DEBUG
-    print_debug_info(chip8);
-#endif
-
-    // Emulate opcode
-    switch ((chip8->inst.opcode >> 12) & 0x0F) {
-        case 0x00:
-            if (chip8->inst.NN == 0xE0) {
-                // 0x00E0: Clear the screen
-                memset(&chip8->display[0], false, sizeof chip8->display);
-                chip8->draw = true; // Will update screen on next 60hz tick
-
-            } else if (chip8->inst.NN == 0xEE) {
-                // 0x00EE: Return from subroutine
-                // Set program counter to last address on subroutine stack ("pop" it off the stack)
-                //   so that next opcode will be gotten from that address.
-                chip8->PC = *--chip8->stack_ptr;
-
-            } else {
-                // Unimplemented/invalid opcode, may be 0xNNN for calling machine code routine for RCA1802
-            }
-
-            break;
-
-        case 0x01:
-            // 0x1NNN: Jump to address NNN
-            chip8->PC = chip8->inst.NNN;    // Set program counter so that next opcode is from NNN
-            break;
-
-        case 0x02:
-            // 0x2NNN: Call subroutine at NNN
-            // Store current address to return to on subroutine stack ("push" it on the stack)
-            //   and set program counter to subroutine address so that the next opcode
-            //   is gotten from there.
-            *chip8->stack_ptr++ = chip8->PC;  
-            chip8->PC = chip8->inst.NNN;
-            break;
-
-        case 0x03:
-            // 0x3XNN: Check if VX == NN, if so, skip the next instruction
-            if (chip8->V[chip8->inst.X] == chip8->inst.NN)
-                chip8->PC += 2;       // Skip next opcode/instruction
-            break;
-
-        case 0x04:
-            // 0x4XNN: Check if VX != NN, if so, skip the next instruction
-            if (chip8->V[chip8->inst.X] != chip8->inst.NN)
-                chip8->PC += 2;       // Skip next opcode/instruction
-            break;
-
-        case 0x05:
-            // 0x5XY0: Check if VX == VY, if so, skip the next instruction
-            if (chip8->inst.N != 0) break; // Wrong opcode
-
-            if (chip8->V[chip8->inst.X] == chip8->V[chip8->inst.Y])
-                chip8->PC += 2;       // Skip next opcode/instruction
-            
-            break;
-
-        case 0x06:
-            // 0x6XNN: Set register VX to NN
-            chip8->V[chip8->inst.X] = chip8->inst.NN;
-            break;
-
-        case 0x07:
-            // 0x7XNN: Set register VX += NN
-            chip8->V[chip8->inst.X] += chip8->inst.NN;
-            break;
-
-        case 0x08:
-            switch(chip8->inst.N) {
-                case 0:
-                    // 0x8XY0: Set register VX = VY
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y];
-                    break;
-
-                case 1:
-                    // 0x8XY1: Set register VX |= VY
-                    chip8->V[chip8->inst.X] |= chip8->V[chip8->inst.Y];
-                    if (config.current_extension == CHIP8)
-                        chip8->V[0xF] = 0;  // Reset VF to 0
-                    break;
-
-                case 2:
-                    // 0x8XY2: Set register VX &= VY
-                    chip8->V[chip8->inst.X] &= chip8->V[chip8->inst.Y];
-                    if (config.current_extension == CHIP8)
-                        chip8->V[0xF] = 0;  // Reset VF to 0
-                    break;
-
-                case 3:
-                    // 0x8XY3: Set register VX ^= VY
-                    chip8->V[chip8->inst.X] ^= chip8->V[chip8->inst.Y];
-                    if (config.current_extension == CHIP8)
-                        chip8->V[0xF] = 0;  // Reset VF to 0
-                    break;
-
-                case 4:
-                    // 0x8XY4: Set register VX += VY, set VF to 1 if carry, 0 if not 
-                    carry = ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255);
-
-                    chip8->V[chip8->inst.X] += chip8->V[chip8->inst.Y];
-                    chip8->V[0xF] = carry; 
-                    break;
-
-                case 5: 
-                    // 0x8XY5: Set register VX -= VY, set VF to 1 if there is not a borrow (result is positive/0)
-                    carry = (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]);
-
-                    chip8->V[chip8->inst.X] -= chip8->V[chip8->inst.Y];
-                    chip8->V[0xF] = carry;
-                    break;
-
-                case 6:
-                    // 0x8XY6: Set register VX >>= 1, store shifted off bit in VF
-                    if (config.current_extension == CHIP8) {
-                        carry = chip8->V[chip8->inst.Y] & 1;    // Use VY
-                        chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] >> 1; // Set VX = VY result
-                    } else {
-                        carry = chip8->V[chip8->inst.X] & 1;    // Use VX
-                        chip8->V[chip8->inst.X] >>= 1;          // Use VX
-                    }
-
-                    chip8->V[0xF] = carry;
-                    break;
-
-                case 7:
-                    // 0x8XY7: Set register VX = VY - VX, set VF to 1 if there is not a borrow (result is positive/0)
-                    carry = (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]);
-
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X];
-                    chip8->V[0xF] = carry;
-                    break;
-
-                case 0xE:
-                    // 0x8XYE: Set register VX <<= 1, store shifted off bit in VF
-                    if (config.current_extension == CHIP8) { 
-                        carry = (chip8->V[chip8->inst.Y] & 0x80) >> 7; // Use VY
-                        chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] << 1; // Set VX = VY result
-                    } else {
-                        carry = (chip8->V[chip8->inst.X] & 0x80) >> 7;  // VX
-                        chip8->V[chip8->inst.X] <<= 1;                  // Use VX
-                    }
-
-                    chip8->V[0xF] = carry;
-                    break;
-
-                default:
-                    // Wrong/unimplemented opcode
-                    break;
-            }
-            break;
-
-        case 0x09:
-            // 0x9XY0: Check if VX != VY; Skip next instruction if so
-            if (chip8->V[chip8->inst.X] != chip8->V[chip8->inst.Y])
-                chip8->PC += 2;
-            break;
-
-        case 0x0A:
-            // 0xANNN: Set index register I to NNN
-            chip8->I = chip8->inst.NNN;
-            break;
-
-        case 0x0B:
-            // 0xBNNN: Jump to V0 + NNN
-            chip8->PC = chip8->V[0] + chip8->inst.NNN;
-            break;
-
-        case 0x0C:
-            // 0xCXNN: Sets register VX = rand() % 256 & NN (bitwise AND)
-            chip8->V[chip8->inst.X] = (rand() % 256) & chip8->inst.NN;
-            break;
-
-        case 0x0D: {
-            // 0xDXYN: Draw N-height sprite at coords X,Y; Read from memory location I;
-            //   Screen pixels are XOR'd with sprite bits, 
-            //   VF (Carry flag) is set if any screen pixels are set off; This is useful
-            //   for collision detection or other reasons.
-            uint8_t X_coord = chip8->V[chip8->inst.X] % config.window_width;
-            uint8_t Y_coord = chip8->V[chip8->inst.Y] % config.window_height;
-            const uint8_t orig_X = X_coord; // Original X value
-
-            chip8->V[0xF] = 0;  // Initialize carry flag to 0
-
-            // Loop over all N rows of the sprite
-            for (uint8_t i = 0; i < chip8->inst.N; i++) {
-                // Get next byte/row of sprite data
-                const uint8_t sprite_data = chip8->ram[chip8->I + i];
-                X_coord = orig_X;   // Reset X for next row to draw
-
-                for (int8_t j = 7; j >= 0; j--) {
-                    // If sprite pixel/bit is on and display pixel is on, set carry flag
-                    bool *pixel = &chip8->display[Y_coord * config.window_width + X_coord]; 
-                    const bool sprite_bit = (sprite_data & (1 << j));
-
-                    if (sprite_bit && *pixel) {
-                        chip8->V[0xF] = 1;  
-                    }
-
-                    // XOR display pixel with sprite pixel/bit to set it on or off
-                    *pixel ^= sprite_bit;
-
-                    // Stop drawing this row if hit right edge of screen
-                    if (++X_coord >= config.window_width) break;
-                }
-
-                // Stop drawing entire sprite if hit bottom edge of screen
-                if (++Y_coord >= config.window_height) break;
-            }
-            chip8->draw = true; // Will update screen on next 60hz tick
-            break;
-        }
-
-        case 0x0E:
-            if (chip8->inst.NN == 0x9E) {
-                // 0xEX9E: Skip next instruction if key in VX is pressed
-                if (chip8->keypad[chip8->V[chip8->inst.X]])
-                    chip8->PC += 2;
-
-            } else if (chip8->inst.NN == 0xA1) {
-                // 0xEX9E: Skip next instruction if key in VX is not pressed
-                if (!chip8->keypad[chip8->V[chip8->inst.X]])
-                    chip8->PC += 2;
-            }
-            break;
-
-        case 0x0F:
-            switch (chip8->inst.NN) {
-                case 0x0A: {
-                    // 0xFX0A: VX = get_key(); Await until a keypress, and store in VX
-                    static bool any_key_pressed = false;
-                    static uint8_t key = 0xFF;
-
-                    for (uint8_t i = 0; key == 0xFF && i < sizeof chip8->keypad; i++) 
-                        if (chip8->keypad[i]) {
-                            key = i;    // Save pressed key to check until it is released
-                            any_key_pressed = true;
-                            break;
-                        }
-
-                    // If no key has been pressed yet, keep getting the current opcode & running this instruction
-                    if (!any_key_pressed) chip8->PC -= 2; 
-                    else {
-                        // A key has been pressed, also wait until it is released to set the key in VX
-                        if (chip8->keypad[key])     // "Busy loop" CHIP8 emulation until key is released
-                            chip8->PC -= 2;
-                        else {
-                            chip8->V[chip8->inst.X] = key;     // VX = key 
-                            key = 0xFF;                        // Reset key to not found 
-                            any_key_pressed = false;           // Reset to nothing pressed yet
-                        }
-                    }
-                    break;
-                }
-
-                case 0x1E:
-                    // 0xFX1E: I += VX; Add VX to register I. For non-Amiga CHIP8, does not affect VF
-                    chip8->I += chip8->V[chip8->inst.X];
-                    break;
-
-                case 0x07:
-                    // 0xFX07: VX = delay timer
-                    chip8->V[chip8->inst.X] = chip8->delay_timer;
-                    break;
-
-                case 0x15:
-                    // 0xFX15: delay timer = VX 
-                    chip8->delay_timer = chip8->V[chip8->inst.X];
-                    break;
-
-                case 0x18:
-                    // 0xFX18: sound timer = VX 
-                    chip8->sound_timer = chip8->V[chip8->inst.X];
-                    break;
-
-                case 0x29:
-                    // 0xFX29: Set register I to sprite location in memory for character in VX (0x0-0xF)
-                    chip8->I = chip8->V[chip8->inst.X] * 5;
-                    break;
-
-                case 0x33: {
-                    // 0xFX33: Store BCD representation of VX at memory offset from I;
-                    //   I = hundred's place, I+1 = ten's place, I+2 = one's place
-                    uint8_t bcd = chip8->V[chip8->inst.X]; 
-                    chip8->ram[chip8->I+2] = bcd % 10;
-                    bcd /= 10;
-                    chip8->ram[chip8->I+1] = bcd % 10;
-                    bcd /= 10;
-                    chip8->ram[chip8->I] = bcd;
-                    break;
-                }
-
-                case 0x55:
-                    // 0xFX55: Register dump V0-VX inclusive to memory offset from I;
-                    //   SCHIP does not increment I, CHIP8 does increment I
-                    for (uint8_t i = 0; i <= chip8->inst.X; i++)  {
-                        if (config.current_extension == CHIP8) 
-                            chip8->ram[chip8->I++] = chip8->V[i]; // Increment I each time
-                        else
-                            chip8->ram[chip8->I + i] = chip8->V[i]; 
-                    }
-                    break;
-
-                case 0x65:
-                    // 0xFX65: Register load V0-VX inclusive from memory offset from I;
-                    //   SCHIP does not increment I, CHIP8 does increment I
-                    for (uint8_t i = 0; i <= chip8->inst.X; i++) {
-                        if (config.current_extension == CHIP8) 
-                            chip8->V[i] = chip8->ram[chip8->I++]; // Increment I each time
-                        else
-                            chip8->V[i] = chip8->ram[chip8->I + i];
-                    }
-                    break;
-
-                default:
-                    break;
-            }
-            break;
-            
-        default:
-            break;  // Unimplemented or invalid opcode
-    }
-}
-
-// Update CHIP8 delay and sound timers every 60hz
-void update_timers(const sdl_t sdl, chip8_t *chip8) {
-    if (chip8->delay_timer > 0) 
-        chip8->delay_timer--;
-
-    if (chip8->sound_timer > 0) {
-        chip8->sound_timer--;
-        SDL_PauseAudioDevice(sdl.dev, 0); // Play sound
-    } else {
-        SDL_PauseAudioDevice(sdl.dev, 1); // Pause sound
-    }
-}
-
 // Da main squeeze
 int main(int argc, char **argv) {
+    const uint64_t start_time = SDL_GetPerformanceCounter();
+
     // Default Usage message for args
     if (argc < 2) {
-       fprintf(stderr, "Usage: %s <rom_name>\n", argv[0]);
+       fprintf(stderr, "Usage: %s <rom_name> [options], --help for the options\n", argv[0]);
        exit(EXIT_FAILURE);
     }
+    const char *rom_name = argv[1];
+
+    // Options from a config file go in front of the command line ones
+    if (!expand_config_file(&argc, &argv)) exit(EXIT_FAILURE);
 
     // Initialize emulator configuration/options
     config_t config = {0};
-    if (!set_config_from_args(&config, argc, argv)) exit(EXIT_FAILURE);
+    const frontend_option_t debugger_options[] = {
+        {"--break-pc", true}, {"--break-read", true}, {"--break-write", true}, {"--break-if", true},
+        {NULL, false},
+    };
+    if (!set_config_from_args(&config, argc, argv, debugger_options)) exit(EXIT_FAILURE);
+
+    const uint64_t config_time = SDL_GetPerformanceCounter();
+
+    // Load and analyze the ROM while SDL and the window come up, SDL threads don't need 
+    //   SDL_Init. Known ROMs get the right quirks, speed and arrow keys without any options.
+    static rom_loader_t loader;
+    loader.config = config;
+    loader.rom_name = rom_name;
+    SDL_Thread *loader_thread = SDL_CreateThread(rom_loader_thread, "rom loader", &loader);
+    if (!loader_thread) rom_loader_thread(&loader);
 
-    // Initialize SDL
+    // Initialize SDL, only what this run needs
     sdl_t sdl = {0};
-    if (!init_sdl(&sdl, &config)) exit(EXIT_FAILURE);
+    static audio_t audio = {0};     // Shared with the audio thread for the life of the program
+    if (!init_video(&sdl, &config)) exit(EXIT_FAILURE);
+    const uint64_t video_time = SDL_GetPerformanceCounter();
+
+    if (loader_thread) SDL_WaitThread(loader_thread, NULL);
+    const uint64_t loaded_time = SDL_GetPerformanceCounter();
+    if (!loader.rom) exit(EXIT_FAILURE);
+    const rom_t *rom = loader.rom;
+    config = loader.config;
+
+    // No audio device when it could never make a sound
+    const bool want_audio = !config.mute && !config.turbo && loader.may_use_sound;
+    if (want_audio && !init_audio(&sdl, &config, &audio)) exit(EXIT_FAILURE);
+    audio_t *audio_out = want_audio ? &audio : NULL;
+    const uint64_t audio_time = SDL_GetPerformanceCounter();
+
+    if (loader.known) 
+        printf("%s: using %s quirks, %u instructions/s\n", rom->name, 
+               config.current_extension == CHIP8 ? "CHIP-8" : 
+               config.current_extension == SUPERCHIP ? "SUPER-CHIP" : "XO-CHIP", 
+               config.insts_per_second);
+
+    // Different random numbers every run unless a seed was given, it goes in movies so 
+    //   replays get the same numbers
+    if (!(config.given & GIVEN_SEED)) config.rng_seed = time(NULL);
+
+#ifdef PROFILE
+    static profile_t profile;
+    config.profile = &profile;
+#endif
+#ifdef TRACE
+    static trace_t trace;
+    config.trace = &trace;
+#endif
 
-    // Initialize CHIP8 machine
     chip8_t chip8 = {0};
-    const char *rom_name = argv[1];
-    if (!init_chip8(&chip8, config, rom_name)) exit(EXIT_FAILURE);
+    if (!init_chip8(&chip8, config, rom)) exit(EXIT_FAILURE);
+
+    // Up to 10 minutes of frame snapshots for rewinding
+    static rewind_t rewind;
+    if (!rewind_init(&rewind, rom, 4 * 1024 * 1024, 10 * 60 * 60)) {
+        SDL_Log("Could not allocate rewind buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Save states are written in the background
+    static save_writer_t writer;
+    if (!save_writer_init(&writer)) exit(EXIT_FAILURE);
 
     // Initial screen clear to background color
-    clear_screen(sdl, config);
+    if (sdl.renderer) clear_screen(sdl, config);
+
+    static movie_t movie;
+    if (config.record_movie) movie_start(&movie, rom, config);
+
+    // Breakpoints, watchpoints and conditions from the command line, F10 steps while paused
+    static debugger_t debugger;
+    if (!debugger_from_args(&debugger, argc, argv)) exit(EXIT_FAILURE);
+    config.debugger = &debugger;
+
+    // Host hardware counters around each frame with --perf, reported at exit
+    static perfcount_t perf;
+    const bool counting = config.perf_counters && perfcount_open(&perf);
 
-    // Seed random number generator
-    srand(time(NULL));
+    // Time each phase of a frame
+    static telemetry_t telemetry;
+    telemetry_init(&telemetry, config.stats_interval_ms);
+    config.telemetry = &telemetry;
+
+    // Main emulator loop, until quit or for --frames frames
+    uint64_t frames = 0;
+    bool startup_reported = false;
+    while (chip8.state != QUIT && (!config.frames || frames < config.frames)) {
+        telemetry_begin_frame(&telemetry);
 
-    // Main emulator loop
-    while (chip8.state != QUIT) {
         // Handle user input
-        handle_input(&chip8, &config);
+        handle_input(&chip8, &config, &writer, &movie, &rewind);
+        save_writer_report(&writer);
+        telemetry_mark(&telemetry, PHASE_INPUT);
 
         if (chip8.state == PAUSED) continue;
 
         // Get time before running instructions 
         const uint64_t start_frame_time = SDL_GetPerformanceCounter();
+        uint32_t insts = 0;
         
-        // Emulate CHIP8 Instructions for this emulator "frame" (60hz)
-        for (uint32_t i = 0; i < config.insts_per_second / 60; i++) {
-            emulate_instruction(&chip8, config);
-
-            // If drawing on CHIP8, only draw 1 sprite this frame (display wait)
-            if ((config.current_extension == CHIP8) && 
-                (chip8.inst.opcode >> 12 == 0xD)) 
-                break;  
+        if (chip8.state == REWINDING) {
+            // Step back 1 frame per 60hz tick, silently
+            stop_recording(&movie, &chip8, config);
+            rewind_step_back(&rewind, &chip8);
+            if (audio_out) {
+                audio_set_sound(audio_out, config, false, 0);
+                audio_end_frame(audio_out, config);
+            }
+            telemetry_mark(&telemetry, PHASE_EMULATE);
+        } else {
+            // Emulate CHIP8 Instructions for this emulator "frame" (60hz), 
+            //   and update delay & sound timers
+            if (!movie_record_frame(&movie, &chip8)) 
+                puts("Out of memory recording movie, recording stopped.");
+            if (counting) perfcount_begin_frame(&perf, config);
+            insts = emulate_frame(&chip8, config, audio_out);
+            frames++;
+            if (counting) perfcount_end_frame(&perf, config, insts);
+            if (chip8.state == PAUSED) debugger_report(&debugger, &chip8);  // Breakpoint or --oob trap
+            rewind_push(&rewind, &chip8);
+            telemetry_mark(&telemetry, PHASE_SNAPSHOT);
         }
 
         // Get time elapsed after running instructions
@@ -1200,19 +523,52 @@ int main(int argc, char **argv) {
         // Delay for approximately 60hz/60fps (16.67ms) or actual time elapsed
         const double time_elapsed = (double)((end_frame_time - start_frame_time) * 1000) / SDL_GetPerformanceFrequency();
 
-        SDL_Delay(16.67f > time_elapsed ? 16.67f - time_elapsed : 0);
+        if (!config.turbo) SDL_Delay(16.67f > time_elapsed ? 16.67f - time_elapsed : 0);
+        telemetry_mark(&telemetry, PHASE_SLEEP);
 
-        // Update window with changes every 60hz
-        if (chip8.draw) {
+        // Update window with changes every 60hz, every frame with the overlay on
+        if (sdl.renderer && (chip8.draw || config.stats_overlay)) {
           update_screen(sdl, config, &chip8);
+          if (config.stats_overlay) draw_stats_overlay(sdl, config, &chip8, &telemetry);
+          telemetry_mark(&telemetry, PHASE_RENDER);
+
+          SDL_RenderPresent(sdl.renderer);
+          telemetry_mark(&telemetry, PHASE_PRESENT);
           chip8.draw = false;
         }
-        
-        // Update delay & sound timers every 60hz
-        update_timers(sdl, &chip8);
+
+        if (audio_out) 
+            telemetry.audio_latency_us = atomic_load_explicit(&audio_out->measured_latency_us, 
+                                                              memory_order_relaxed);
+        if (telemetry_end_frame(&telemetry, insts) && config.stats_file) 
+            telemetry_write(&telemetry, config.stats_file);
+
+        // Time to the first frame on screen, by startup phase
+        if (config.startup_times && !startup_reported && frames == 1) {
+            startup_reported = true;
+            const uint64_t now = SDL_GetPerformanceCounter();
+            printf("Startup: config %.1fms, video %.1fms, ROM load and analysis %.1fms "
+                   "(waited %.1fms for it), audio %.1fms%s, first frame %.1fms, total %.1fms\n",
+                   ticks_ms(config_time - start_time), ticks_ms(video_time - config_time), 
+                   ticks_ms(loader.ticks), ticks_ms(loaded_time - video_time), 
+                   ticks_ms(audio_time - loaded_time), want_audio ? "" : " (skipped)", 
+                   ticks_ms(now - audio_time), ticks_ms(now - start_time));
+        }
     }
 
     // Final cleanup
+    if (counting) {
+        perfcount_report(&perf, stdout);
+        perfcount_close(&perf);
+    }
+    stop_recording(&movie, &chip8, config);
+    movie_free(&movie);
+#ifdef PROFILE
+    profile_dump(&profile, rom->name);
+#endif
+    save_writer_quit(&writer);
+    rewind_free(&rewind);
+    romlib_close(&loader.roms);
     final_cleanup(sdl); 
 
     exit(EXIT_SUCCESS);
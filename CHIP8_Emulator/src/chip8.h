@@ -0,0 +1,255 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+// CHIP8 core: machine state and instruction emulation, shared by the SDL frontend 
+//   and the headless runner. Nothing in here depends on SDL.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Emulator states
+typedef enum {
+    QUIT,
+    RUNNING,
+    PAUSED,
+    REWINDING,
+} emulator_state_t;
+
+// CHIP-8 extensions/quirks support
+typedef enum {
+    CHIP8,
+    SUPERCHIP,
+    XOCHIP,
+} extension_t;
+
+// Extra host key mappings for the arrow keys, on top of the QWERTY keypad
+typedef enum {
+    KEYPAD_QWERTY,          // No arrow keys, QWERTY block only
+    KEYPAD_ARROWS_2468,     // Arrows -> 2/8/4/6, the usual up/down/left/right
+    KEYPAD_ARROWS_TETRIS,   // Left/right -> 5/6, up (rotate) -> 4, down (drop) -> 7
+} keypad_layout_t;
+
+// What happens on an out of range RAM address, stack push/pop or keypad index. Every access 
+//   wraps either way, so nothing reads or writes outside the machine; this is what the 
+//   frontend gets told, once a frame.
+typedef enum {
+    OOB_WRAP,       // Nothing, it's how the hardware behaves
+    OOB_LOG,        // Print each kind of fault the first time it happens
+    OOB_TRAP,       // Pause the machine
+} oob_policy_t;
+
+// Options given on the command line or in a config file, config_t.given. Whatever fills 
+//   in values later (the quirk database, the frontend's clock seed) leaves these alone.
+#define GIVEN_QUIRKS (1 << 0)     // --quirks
+#define GIVEN_IPS    (1 << 1)     // --ips
+#define GIVEN_SEED   (1 << 2)     // --seed, any value including 0
+
+typedef struct profile profile_t;
+typedef struct trace trace_t;
+typedef struct telemetry telemetry_t;
+typedef struct debugger debugger_t;
+
+// Emulator configuration object
+typedef struct {
+    uint32_t window_width;      // SDL window width
+    uint32_t window_height;     // SDL window height
+    uint32_t fg_color;          // Foreground color RGBA8888
+    uint32_t bg_color;          // Background color RGBA8888
+    uint32_t scale_factor;      // Amount to scale a CHIP8 pixel by e.g. 20x will be a 20x larger window
+    bool pixel_outlines;        // Draw pixel "outlines" yes/no
+    uint32_t insts_per_second;  // CHIP8 CPU "clock rate" or hz
+    uint32_t square_wave_freq;  // Frequency of square wave sound e.g. 440hz for middle A
+    uint32_t audio_sample_rate; 
+    uint16_t audio_buffer_samples;  // SDL audio device buffer size in samples
+    uint32_t audio_latency_ms;  // Requested delay between an emulated sound event and playback
+    int16_t volume;             // How loud or not is the sound
+    float color_lerp_rate;      // Amount to lerp colors by, between [0.1, 1.0]
+    extension_t current_extension;  // Current quirks/extension support for e.g. CHIP8 vs. SUPERCHIP
+    keypad_layout_t keypad_layout;  // Arrow key mapping
+    bool quirk_db;              // Pick quirks/speed/keypad from the ROM database when the ROM is known
+    uint32_t given;             // GIVEN_* options set explicitly
+    uint8_t save_slot;          // Save state slot used by F5/F9, 0-9
+    const char *rom_index;      // On-disk ROM library index file, NULL for none
+    const char *record_movie;   // Record input to this movie file, NULL for none
+    uint64_t rng_seed;          // Seed for the machine's random number generator (CXNN)
+    telemetry_t *telemetry;     // Frame phase timing, NULL for none
+    const char *stats_file;     // Write frame timing stats here every stats interval, NULL for none
+    uint32_t stats_interval_ms; // Frame timing window length
+    bool stats_overlay;         // Draw frame timing stats over the display
+    debugger_t *debugger;       // Breakpoints/watchpoints, NULL for none
+    bool perf_counters;         // Count host cycles/instructions/misses per frame (Linux)
+    bool turbo;                 // Don't wait for the next 60hz tick, no sound
+    const char *renderer;       // SDL render driver name, NULL for SDL's choice
+    bool vsync;                 // Present on vsync
+    bool headless;              // No window
+    bool mute;                  // No sound, volume 0
+    bool startup_times;         // Print how long each startup phase took
+    uint64_t frames;            // Stop after this many frames, 0 for never
+    const char *wav_file;       // Write rendered audio here (headless), NULL for none
+    const char *sound_bits_file;    // Write per frame sound on/off bits here (headless), NULL for none
+    const char *trace_file;     // Instruction trace dumps go here
+    uint32_t threads;           // ROMs the headless runner runs at once
+    oob_policy_t oob_policy[XOCHIP + 1];    // Out of range access policy per quirks profile
+#ifdef PROFILE
+    profile_t *profile;         // Count instructions here, NULL for none
+#endif
+#ifdef TRACE
+    trace_t *trace;             // Record executed instructions here, NULL for none
+#endif
+} config_t;
+
+// CHIP8 Instruction format
+typedef struct {
+    uint16_t opcode;
+    uint16_t NNN;   // 12 bit address/constant
+    uint8_t NN;     // 8 bit constant
+    uint8_t N;      // 4 bit constant
+    uint8_t X;      // 4 bit register identifier
+    uint8_t Y;      // 4 bit register identifier
+} instruction_t;
+
+#define CHIP8_ENTRY_POINT 0x200   // CHIP8 Roms will be loaded to 0x200
+#define CHIP8_RAM_SIZE 4096
+#define CHIP8_RAM_MASK (CHIP8_RAM_SIZE - 1)
+#define CHIP8_RAM_GUARD 16        // Bytes after RAM mirroring its start, so a sprite read never leaves it
+#define CHIP8_STACK_SIZE 12
+#define CHIP8_PAGE_SIZE 256       // RAM page size for dirty tracking, see clone.h
+#define CHIP8_PAGES (CHIP8_RAM_SIZE / CHIP8_PAGE_SIZE)
+#define CHIP8_ALL_PAGES ((1u << CHIP8_PAGES) - 1)
+
+// Out of range accesses since the last frame, chip8_t.fault
+#define FAULT_RAM    (1 << 0)   // Address past the end of RAM, wrapped
+#define FAULT_STACK  (1 << 1)   // Push onto a full stack or pop off an empty one, wrapped
+#define FAULT_KEYPAD (1 << 2)   // EX9E/EXA1 with VX > 0xF, masked
+
+// Loaded ROM, kept in memory so the machine can be reset without re-reading the file
+typedef struct {
+    const char *name;       // ROM file name
+    uint8_t image[4096];    // Boot RAM image: font + ROM at the entry point
+    uint32_t size;          // ROM size in bytes
+    uint32_t hash;          // FNV-1a hash of the ROM bytes
+    uint8_t sha1[20];       // SHA-1 of the ROM bytes, identifies the ROM in databases
+} rom_t;
+
+// CHIP8 Machine object
+typedef struct {
+    emulator_state_t state;
+    uint8_t ram[CHIP8_RAM_SIZE + CHIP8_RAM_GUARD];
+    bool display[64*32];    // Emulate original CHIP8 resolution pixels
+    uint32_t pixel_color[64*32];    // CHIP8 pixel colors to draw 
+    uint16_t stack[CHIP8_STACK_SIZE];   // Subroutine stack
+    uint8_t SP;             // Stack pointer, index of next free stack entry
+    uint8_t V[16];          // Data registers V0-VF
+    uint16_t I;             // Index register
+    uint16_t PC;            // Program Counter
+    uint8_t delay_timer;    // Decrements at 60hz when >0
+    uint8_t sound_timer;    // Decrements at 60hz and plays tone when >0 
+    bool keypad[16];        // Hexadecimal keypad 0x0-0xF
+    uint64_t rng;           // Random number generator state for CXNN
+    uint8_t wait_key;       // Key FX0A saw pressed and is waiting on to be released, 0xFF for none
+    const rom_t *rom;       // Currently running ROM
+    instruction_t inst;     // Currently executing instruction
+    bool draw;              // Update the screen yes/no
+    uint8_t fault;          // FAULT_* accesses since the last frame
+    uint8_t faults_logged;  // FAULT_* already printed under OOB_LOG
+    uint16_t dirty_pages;   // RAM pages written since the last clone, bit N for page N
+} chip8_t;
+
+typedef struct audio audio_t;
+
+// An option a frontend parses itself, so set_config_from_args doesn't reject it
+typedef struct {
+    const char *name;
+    bool has_value;
+} frontend_option_t;
+
+// Set up initial emulator configuration from passed in arguments. Options other than the
+//   config's own and frontend_options (ending in a NULL name, or NULL for none) are an error.
+bool set_config_from_args(config_t *config, const int argc, char **argv, 
+                          const frontend_option_t *frontend_options);
+bool is_config_flag(const char *arg);
+void print_config_usage(FILE *out);
+
+// Put the options from --config FILE (and --profile NAME) in front of the command line ones
+bool expand_config_file(int *argc, char ***argv);
+
+uint32_t fnv1a_hash(const uint8_t *data, const size_t size);
+
+// Blend start_color towards end_color by t, both RGBA8888
+uint32_t color_lerp(const uint32_t start_color, const uint32_t end_color, const float t);
+
+// Initialize CHIP8 machine
+bool init_chip8(chip8_t *chip8, const config_t config, const rom_t *rom);
+
+// Copy the start of RAM into the guard bytes and mark all RAM dirty, after writing RAM 
+//   other than through the core
+void sync_ram_guard(chip8_t *chip8);
+
+// Emulate 1 CHIP8 instruction
+void emulate_instruction(chip8_t *chip8, const config_t config);
+
+// Emulate 1 CHIP8 instruction checking config.debugger's breakpoints, watchpoints and 
+//   conditions. Returns false if one hit and the machine was paused.
+bool emulate_instruction_debug(chip8_t *chip8, const config_t config);
+
+// Emulate 1 60hz frame of instructions and tick the timers, sound changes are pushed
+//   to audio if not NULL. Returns the number of instructions emulated.
+uint32_t emulate_frame(chip8_t *chip8, const config_t config, audio_t *audio);
+
+// Update CHIP8 delay and sound timers every 60hz
+void update_timers(chip8_t *chip8);
+
+// Little endian helpers for the on-disk formats
+static inline void put_u16(uint8_t *buf, const uint16_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static inline void put_u32(uint8_t *buf, const uint32_t value) {
+    put_u16(&buf[0], value & 0xFFFF);
+    put_u16(&buf[2], value >> 16);
+}
+
+static inline uint16_t get_u16(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t *buf) {
+    return get_u16(&buf[0]) | ((uint32_t)get_u16(&buf[2]) << 16);
+}
+
+static inline void put_u64(uint8_t *buf, const uint64_t value) {
+    put_u32(&buf[0], value & 0xFFFFFFFF);
+    put_u32(&buf[4], value >> 32);
+}
+
+static inline uint64_t get_u64(const uint8_t *buf) {
+    return get_u32(&buf[0]) | ((uint64_t)get_u32(&buf[4]) << 32);
+}
+
+// Save states, see state.c for the format
+#define CHIP8_STATE_VERSION 2
+#define CHIP8_STATE_HEADER_SIZE 328
+#define CHIP8_STATE_MAX_SIZE (CHIP8_STATE_HEADER_SIZE + 2 + 4096 + 4 * (4096 / 5 + 1))
+
+void pack_display(const bool *display, uint8_t *packed);
+void unpack_display(const uint8_t *packed, bool *display);
+void serialize_header(const chip8_t *chip8, uint8_t *buf);
+void deserialize_header(chip8_t *chip8, const uint8_t *buf);
+size_t serialize_state(const chip8_t *chip8, uint8_t *buf, const size_t buf_size);
+bool deserialize_state(chip8_t *chip8, const uint8_t *buf, const size_t size);
+bool write_file_atomic(const char *filename, const uint8_t *buf, const size_t size);
+bool save_state(const chip8_t *chip8, const char *filename);
+bool load_state(chip8_t *chip8, const char *filename);
+
+// Monotonic host clock in nanoseconds
+uint64_t monotonic_ns(void);
+
+#ifdef DEBUG
+void print_debug_info(chip8_t *chip8);
+#endif
+
+#endif // CHIP8_H
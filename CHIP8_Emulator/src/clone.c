@@ -0,0 +1,133 @@
+#include "clone.h"
+
+// Set up a pool of page_count RAM pages shared by all clones of one machine. Each clone
+//   holds CHIP8_PAGES references, but only pages that were written take up a page of their own.
+bool clone_pool_init(clone_pool_t *pool, const uint32_t page_count) {
+    memset(pool, 0, sizeof *pool);
+
+    pool->pages = malloc((size_t)page_count * sizeof *pool->pages);
+    pool->refs = calloc(page_count, sizeof *pool->refs);
+    pool->free_list = malloc((size_t)page_count * sizeof *pool->free_list);
+    if (!pool->pages || !pool->refs || !pool->free_list || page_count < CHIP8_PAGES) {
+        clone_pool_free(pool);
+        return false;
+    }
+    pool->page_count = page_count;
+
+    // Hand out low pages first, they're the warmest
+    for (uint32_t i = 0; i < page_count; i++)
+        pool->free_list[i] = page_count - 1 - i;
+    pool->free_count = page_count;
+
+    // The machine's RAM doesn't match any page yet, the first save copies all of it
+    for (int p = 0; p < CHIP8_PAGES; p++)
+        pool->origin[p] = CLONE_NO_PAGE;
+
+    return true;
+}
+
+void clone_pool_free(clone_pool_t *pool) {
+    free(pool->pages);
+    free(pool->refs);
+    free(pool->free_list);
+    pool->pages = NULL;
+    pool->refs = NULL;
+    pool->free_list = NULL;
+    pool->free_count = pool->page_count = 0;
+}
+
+static void page_unref(clone_pool_t *pool, const uint32_t page) {
+    if (page != CLONE_NO_PAGE && --pool->refs[page] == 0)
+        pool->free_list[pool->free_count++] = page;
+}
+
+bool clone_save(clone_pool_t *pool, chip8_t *chip8, chip8_clone_t *clone) {
+    // Pages the machine wrote, or never had saved, need a page of their own
+    uint32_t copy = chip8->dirty_pages, needed = 0;
+    for (int p = 0; p < CHIP8_PAGES; p++) {
+        if (pool->origin[p] == CLONE_NO_PAGE) copy |= 1u << p;
+        needed += (copy >> p) & 1;
+    }
+    if (needed > pool->free_count) {
+        for (int p = 0; p < CHIP8_PAGES; p++)
+            clone->pages[p] = CLONE_NO_PAGE;
+        return false;
+    }
+
+    for (int p = 0; p < CHIP8_PAGES; p++) {
+        if (copy & (1u << p)) {
+            const uint32_t page = pool->free_list[--pool->free_count];
+            memcpy(pool->pages[page], &chip8->ram[p * CHIP8_PAGE_SIZE], CHIP8_PAGE_SIZE);
+            pool->refs[page] = 1;   // The machine's reference
+            page_unref(pool, pool->origin[p]);
+            pool->origin[p] = page;
+        }
+        clone->pages[p] = pool->origin[p];
+        pool->refs[pool->origin[p]]++;
+    }
+    chip8->dirty_pages = 0;
+
+    clone->rng = chip8->rng;
+    clone->PC = chip8->PC;
+    clone->I = chip8->I;
+    memcpy(clone->stack, chip8->stack, sizeof clone->stack);
+    clone->SP = chip8->SP;
+    clone->delay_timer = chip8->delay_timer;
+    clone->sound_timer = chip8->sound_timer;
+    clone->wait_key = chip8->wait_key;
+    memcpy(clone->V, chip8->V, sizeof clone->V);
+    memcpy(clone->keypad, chip8->keypad, sizeof clone->keypad);
+    clone->state = chip8->state;
+    pack_display(chip8->display, clone->display);
+
+    return true;    // Success
+}
+
+bool clone_restore(clone_pool_t *pool, chip8_t *chip8, const chip8_clone_t *clone) {
+    for (int p = 0; p < CHIP8_PAGES; p++)
+        if (clone->pages[p] == CLONE_NO_PAGE) return false;
+
+    // Only pages that differ from what the machine holds get copied back
+    for (int p = 0; p < CHIP8_PAGES; p++) {
+        const uint32_t page = clone->pages[p];
+        if (page == pool->origin[p] && !(chip8->dirty_pages & (1u << p))) continue;
+
+        memcpy(&chip8->ram[p * CHIP8_PAGE_SIZE], pool->pages[page], CHIP8_PAGE_SIZE);
+        pool->refs[page]++;
+        page_unref(pool, pool->origin[p]);
+        pool->origin[p] = page;
+        if (p == 0)
+            memcpy(&chip8->ram[CHIP8_RAM_SIZE], &chip8->ram[0], CHIP8_RAM_GUARD);
+    }
+    chip8->dirty_pages = 0;
+
+    chip8->rng = clone->rng;
+    chip8->PC = clone->PC;
+    chip8->I = clone->I;
+    memcpy(chip8->stack, clone->stack, sizeof chip8->stack);
+    chip8->SP = clone->SP;
+    chip8->delay_timer = clone->delay_timer;
+    chip8->sound_timer = clone->sound_timer;
+    chip8->wait_key = clone->wait_key;
+    memcpy(chip8->V, clone->V, sizeof chip8->V);
+    memcpy(chip8->keypad, clone->keypad, sizeof chip8->keypad);
+    chip8->state = clone->state;
+    unpack_display(clone->display, chip8->display);
+    chip8->fault = 0;
+    chip8->draw = true;
+
+    return true;    // Success
+}
+
+void clone_copy(clone_pool_t *pool, chip8_clone_t *dst, const chip8_clone_t *src) {
+    if (dst != src) *dst = *src;
+    for (int p = 0; p < CHIP8_PAGES; p++)
+        if (src->pages[p] != CLONE_NO_PAGE) pool->refs[src->pages[p]]++;
+}
+
+void clone_release(clone_pool_t *pool, chip8_clone_t *clone) {
+    for (int p = 0; p < CHIP8_PAGES; p++) {
+        page_unref(pool, clone->pages[p]);
+        clone->pages[p] = CLONE_NO_PAGE;
+    }
+}
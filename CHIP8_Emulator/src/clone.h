@@ -0,0 +1,70 @@
+#ifndef CLONE_H
+#define CLONE_H
+
+// Cheap machine clones for tree search: a clone is the architectural state (registers,
+//   stack, timers, keypad, RNG, packed display) plus one reference per 256 byte RAM page
+//   into a shared, reference counted page pool. Pages are copy on write: saving a clone
+//   only copies the pages the machine wrote since its last save or restore (chip8_t's
+//   dirty_pages), everything else is shared with the clone it came from, and restoring
+//   only copies the pages that differ from the ones the machine already holds.
+//
+// A pool tracks which pages one machine's RAM matches, so use one pool per machine.
+//
+//   clone_pool_t pool;
+//   clone_pool_init(&pool, 1 << 16);
+//   chip8_clone_t root, branch;
+//   clone_save(&pool, &chip8, &root);
+//   for each move {
+//       clone_restore(&pool, &chip8, &root);
+//       ...run some frames...
+//       clone_save(&pool, &chip8, &branch);
+//       ...
+//       clone_release(&pool, &branch);
+//   }
+
+#include "chip8.h"
+
+#define CLONE_NO_PAGE UINT32_MAX
+
+typedef struct {
+    uint32_t pages[CHIP8_PAGES];    // RAM page references into the pool
+    uint64_t rng;
+    uint16_t PC;
+    uint16_t I;
+    uint16_t stack[CHIP8_STACK_SIZE];
+    uint8_t SP;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t wait_key;
+    uint8_t V[16];
+    bool keypad[16];
+    emulator_state_t state;
+    uint8_t display[64*32 / 8];     // 1 bit per pixel, as in save states
+} chip8_clone_t;
+
+typedef struct {
+    uint8_t (*pages)[CHIP8_PAGE_SIZE];  // Page contents
+    uint32_t *refs;                 // References to each page, 0 for free pages
+    uint32_t *free_list;            // Free page indices, used as a stack
+    uint32_t free_count;
+    uint32_t page_count;
+    uint32_t origin[CHIP8_PAGES];   // Pages the machine's RAM matches where not dirty, referenced
+} clone_pool_t;
+
+bool clone_pool_init(clone_pool_t *pool, const uint32_t page_count);
+void clone_pool_free(clone_pool_t *pool);
+
+// Save the machine into clone, false if the pool is out of pages (the clone is left empty)
+bool clone_save(clone_pool_t *pool, chip8_t *chip8, chip8_clone_t *clone);
+
+// Put the machine back to clone's state, the clone stays valid. An empty clone (released,
+//   or one whose save failed) can't be restored: returns false and leaves the machine alone.
+bool clone_restore(clone_pool_t *pool, chip8_t *chip8, const chip8_clone_t *clone);
+
+// Another reference to the same state, sharing all its pages
+void clone_copy(clone_pool_t *pool, chip8_clone_t *dst, const chip8_clone_t *src);
+
+// Drop a clone's page references, it can't be restored after this
+void clone_release(clone_pool_t *pool, chip8_clone_t *clone);
+
+#endif // CLONE_H
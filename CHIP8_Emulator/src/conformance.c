@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "romlib.h"
+
+// Conformance harness: runs the bundled test ROMs headless under each quirks profile, with 
+//   scripted key presses where a test needs them, and checks the final framebuffer against 
+//   known good hashes. Any change to how instructions are executed or drawn can be checked 
+//   with one run. Exits with failure if a test doesn't match or runs too slowly.
+
+typedef struct {
+    uint32_t frame;         // Frame the key is pressed at, it's released 6 frames later
+    uint8_t key;
+} key_press_t;
+
+typedef struct {
+    const char *rom;
+    uint32_t frames;
+    const key_press_t *keys[XOCHIP + 1];    // Key script per profile, ends at frame 0
+    uint32_t golden[XOCHIP + 1];            // Display hash per profile
+} conformance_test_t;
+
+static const char *profile_names[] = {"chip8", "superchip", "xochip"};
+
+static const key_press_t no_keys[] = {{0}};
+
+// Timendus quirks test: pick the platform from the menu once it's drawn, SUPER-CHIP has a 
+//   second menu for modern/legacy
+static const key_press_t quirks_chip8[] = {{600, 0x1}, {0}};
+static const key_press_t quirks_superchip[] = {{600, 0x2}, {700, 0x1}, {0}};
+static const key_press_t quirks_xochip[] = {{600, 0x3}, {0}};
+
+// Timendus keypad test: open the FX0A test, then press and release A
+static const key_press_t keypad_fx0a[] = {{300, 0x3}, {500, 0xA}, {0}};
+
+// Golden hashes are this emulator's output, checked by eye with --print. Known differences 
+//   from real hardware they lock in: SUPER-CHIP BXNN jumping and the XO-CHIP quirks.
+static const conformance_test_t tests[] = {
+    {"1-chip8-logo.ch8",  120, {no_keys, no_keys, no_keys}, {0xe8bc935e, 0xe8bc935e, 0xe8bc935e}},
+    {"2-ibm-logo.ch8",    120, {no_keys, no_keys, no_keys}, {0xf56d7266, 0xf56d7266, 0xf56d7266}},
+    {"3-corax+.ch8",      300, {no_keys, no_keys, no_keys}, {0x32b114f2, 0x32b114f2, 0x32b114f2}},
+    {"4-flags.ch8",       300, {no_keys, no_keys, no_keys}, {0x60ed90e5, 0x60ed90e5, 0x60ed90e5}},
+    {"5-quirks.ch8",     1200, {quirks_chip8, quirks_superchip, quirks_xochip}, {0x9c2f5dff, 0x1c563ebc, 0x41ea52c4}},
+    {"6-keypad.ch8",      900, {keypad_fx0a, keypad_fx0a, keypad_fx0a}, {0x9af0c8e2, 0x9af0c8e2, 0x9af0c8e2}},
+    {"7-beep.ch8",        120, {no_keys, no_keys, no_keys}, {0x23e6d62d, 0x23e6d62d, 0x23e6d62d}},
+};
+
+typedef struct {
+    const char *roms_dir;
+    double min_fps;         // Fail tests that emulate fewer frames per second than this
+    bool print;             // Print hashes and screens, for checking and updating golden values
+} conformance_opts_t;
+
+static uint32_t display_hash(const chip8_t *chip8) {
+    uint8_t packed[64*32 / 8];
+    pack_display(chip8->display, packed);
+    return fnv1a_hash(packed, sizeof packed);
+}
+
+static void print_display(const chip8_t *chip8) {
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) 
+            putchar(chip8->display[y * 64 + x] ? '#' : '.');
+        putchar('\n');
+    }
+}
+
+// Run one test under one profile, returns true if it matched and was fast enough
+static bool run_test(const conformance_test_t *test, const extension_t profile, 
+                     const conformance_opts_t *opts) {
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof path, "%s/%s", opts->roms_dir, test->rom);
+
+    static rom_t rom;
+    if (!load_rom(&rom, path)) return false;
+
+    config_t config = {0};
+    char *no_args[] = {"conformance"};
+    set_config_from_args(&config, 1, no_args, NULL);
+    config.current_extension = profile;
+
+    static chip8_t chip8;
+    init_chip8(&chip8, config, &rom);
+
+    const uint64_t start = monotonic_ns();
+
+    for (uint32_t frame = 0; frame < test->frames; frame++) {
+        for (const key_press_t *press = test->keys[profile]; press->frame; press++) 
+            chip8.keypad[press->key] = frame >= press->frame && frame < press->frame + 6;
+        emulate_frame(&chip8, config, NULL);
+    }
+
+    const uint64_t elapsed = monotonic_ns() - start;
+    const double fps = elapsed ? test->frames * 1e9 / elapsed : 0.0;
+    const uint32_t hash = display_hash(&chip8);
+    const uint32_t golden = test->golden[profile];
+
+    const bool match = hash == golden;
+    const bool fast = fps >= opts->min_fps;
+    printf("%-18s %-10s %08x %s  %9.0f fps%s\n", test->rom, profile_names[profile], hash, 
+           match ? "ok      " : "MISMATCH", fps, fast ? "" : "  TOO SLOW");
+    if (opts->print) print_display(&chip8);
+
+    return match && fast;
+}
+
+bool set_conformance_opts_from_args(conformance_opts_t *opts, const int argc, char **argv) {
+    *opts = (conformance_opts_t){
+        .roms_dir = "../roms",
+        .min_fps = 600,     // 10x real time
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--print") == 0) 
+            opts->print = true;
+        else if (strcmp(argv[i], "--roms") == 0 && i + 1 < argc) 
+            opts->roms_dir = argv[++i];
+        else if (strcmp(argv[i], "--min-fps") == 0 && i + 1 < argc) 
+            opts->min_fps = strtod(argv[++i], NULL);
+        else {
+            fprintf(stderr, "Usage: %s [--roms dir] [--min-fps N] [--print]\n", argv[0]);
+            return false;
+        }
+    }
+
+    return true;    // Success
+}
+
+int main(int argc, char **argv) {
+    conformance_opts_t opts;
+    if (!set_conformance_opts_from_args(&opts, argc, argv)) exit(EXIT_FAILURE);
+
+    int failed = 0, total = 0;
+    for (size_t i = 0; i < sizeof tests / sizeof tests[0]; i++) 
+        for (int profile = CHIP8; profile <= XOCHIP; profile++, total++) 
+            failed += !run_test(&tests[i], profile, &opts);
+
+    printf("%d/%d passed\n", total - failed, total);
+    exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,1055 @@
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "chip8.h"
+#ifdef PROFILE
+#include "profile.h"
+#endif
+#include "telemetry.h"
+#include "debugger.h"
+#if defined(DEBUG) || defined(TRACE)
+#include "trace.h"
+#endif
+#include "audio.h"
+
+// Monotonic host clock in nanoseconds
+uint64_t monotonic_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// Options that don't take a value. Each also has a "--no-" form to turn it back off, which 
+//   is what "option = false" in a config file becomes.
+static const char *config_flags[] = {
+    "--pixel-outlines", "--quirk-db", "--no-rom-index", "--stats-overlay", "--perf", "--turbo", 
+    "--vsync", "--headless", "--mute", "--startup-times",
+};
+
+// True if arg is a config option that doesn't take a value, for other argument parsers 
+//   to know not to skip over the next argument
+bool is_config_flag(const char *arg) {
+    const char *name = strncmp(arg, "--no-", 5) == 0 ? arg + 4 : arg;   // "--no-x" -> "-x"
+    for (size_t i = 0; i < sizeof config_flags / sizeof config_flags[0]; i++) {
+        if (strcmp(arg, config_flags[i]) == 0) return true;
+        if (name != arg && strcmp(name, config_flags[i] + 1) == 0) return true;
+    }
+    return false;
+}
+
+// Value of the option at argv[*i], moving *i past it. NULL if it's missing.
+static const char *option_value(const int argc, char **argv, int *i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return NULL;
+    }
+    return argv[++*i];
+}
+
+// Value of the option at argv[*i] as a number from min to max, moving *i past it. The whole
+//   value has to be the number, in base 10 or 16. False if it's missing, junk or out of range.
+static bool option_number(const int argc, char **argv, int *i, const int base,
+                          const uint64_t min, const uint64_t max, uint64_t *number) {
+    const char *option = argv[*i];
+    const char *value = option_value(argc, argv, i);
+    if (!value) return false;
+
+    char *end;
+    errno = 0;
+    *number = strtoull(value, &end, base);
+    const bool digit = base == 16 ? isxdigit((unsigned char)*value) : isdigit((unsigned char)*value);
+    if (!digit || *end || errno == ERANGE || *number < min || *number > max) {
+        if (base == 16)
+            fprintf(stderr, "Bad value %s for %s, expected hex %llX-%llX\n", value, option,
+                    (unsigned long long)min, (unsigned long long)max);
+        else
+            fprintf(stderr, "Bad value %s for %s, expected %llu-%llu\n", value, option,
+                    (unsigned long long)min, (unsigned long long)max);
+        return false;
+    }
+    return true;
+}
+
+// option_number for decimal fractions
+static bool option_float(const int argc, char **argv, int *i, const float min, const float max,
+                         float *number) {
+    const char *option = argv[*i];
+    const char *value = option_value(argc, argv, i);
+    if (!value) return false;
+
+    char *end;
+    *number = strtof(value, &end);
+    if (end == value || *end || !(*number >= min && *number <= max)) {
+        fprintf(stderr, "Bad value %s for %s, expected %.1f-%.1f\n", value, option, min, max);
+        return false;
+    }
+    return true;
+}
+
+void print_config_usage(FILE *out) {
+    fprintf(out, 
+        "Emulation:\n"
+        "  --ips N                 Instructions per second (600)\n"
+        "  --quirks chip8|superchip|xochip  Quirks profile, over the quirk database's\n"
+        "  --no-quirk-db           Don't look ROMs up in the quirk database\n"
+        "  --seed N                Random number seed (from the clock)\n"
+        "  --turbo                 Run as fast as possible, silently\n"
+        "  --frames N              Stop after N frames (never, 600 headless)\n"
+        "  --oob [PROFILE=]POLICY  Out of range RAM/stack/keypad accesses: wrap, log or trap\n"
+        "                          (wrap, xochip=log)\n"
+        "Display:\n"
+        "  --scale-factor N        Window pixels per CHIP8 pixel, 1-100 (20)\n"
+        "  --fg RRGGBBAA, --bg RRGGBBAA  Colors (FFFFFFFF, 000000FF)\n"
+        "  --no-pixel-outlines     Don't outline pixels\n"
+        "  --color-lerp F          Pixel fade rate, 0.1-1.0 (0.7)\n"
+        "  --renderer NAME         SDL render driver, e.g. software, opengl, direct3d11, metal\n"
+        "  --vsync                 Wait for vsync when presenting\n"
+        "  --headless              No window, audio only\n"
+        "  --stats-overlay         Draw frame timing stats\n"
+        "Audio:\n"
+        "  --mute                  No sound\n"
+        "  --volume N              0-32767 (3000)\n"
+        "  --square-wave HZ        Square wave frequency, 1-20000 (440)\n"
+        "  --sample-rate HZ        8000-192000 (44100)\n"
+        "  --audio-buffer N        Device buffer in samples, 16-32768 (512)\n"
+        "  --audio-latency MS      Delay before sound events play, 0-1000 (20)\n"
+        "Capture:\n"
+        "  --record FILE           Record input to a movie\n"
+        "  --wav FILE              Write rendered audio (headless)\n"
+        "  --sound-bitmap FILE     Write per frame sound on/off bits (headless)\n"
+        "  --trace-file FILE       Where instruction traces are dumped (trace.bin)\n"
+        "  --stats-file FILE       Write frame timing stats every interval\n"
+        "  --stats-interval MS     Frame timing window (1000)\n"
+        "Host:\n"
+        "  --threads N             ROMs run at once by the headless runner, 1-1024 (1)\n"
+        "  --perf                  Count host cycles, instructions and misses per frame\n"
+        "  --startup-times         Time each startup phase up to the first frame\n"
+        "  --rom-index FILE        ROM library index (rom_index.txt), --no-rom-index for none\n"
+        "Config files:\n"
+        "  --config FILE           Read options from FILE, [default] section and then\n"
+        "  --profile NAME          the [NAME] section, command line options win\n");
+}
+
+// "wrap", "log" or "trap", for every quirks profile, or "chip8=trap" for one
+static bool parse_oob_policy(config_t *config, const char *value) {
+    static const char *profiles[] = {[CHIP8] = "chip8", [SUPERCHIP] = "superchip", [XOCHIP] = "xochip"};
+    static const char *policies[] = {[OOB_WRAP] = "wrap", [OOB_LOG] = "log", [OOB_TRAP] = "trap"};
+
+    int first = CHIP8, last = XOCHIP;
+    const char *equals = strchr(value, '=');
+    if (equals) {
+        for (first = CHIP8; first <= XOCHIP; first++) 
+            if (strncmp(value, profiles[first], equals - value) == 0 && 
+                strlen(profiles[first]) == (size_t)(equals - value)) break;
+        if (first > XOCHIP) {
+            fprintf(stderr, "Unknown quirks profile in --oob %s\n", value);
+            return false;
+        }
+        last = first;
+        value = equals + 1;
+    }
+
+    for (int policy = OOB_WRAP; policy <= OOB_TRAP; policy++) {
+        if (strcmp(value, policies[policy]) != 0) continue;
+        for (int profile = first; profile <= last; profile++) 
+            config->oob_policy[profile] = (oob_policy_t)policy;
+        return true;
+    }
+    fprintf(stderr, "Unknown --oob policy %s, expected wrap, log or trap\n", value);
+    return false;
+}
+
+// Set up initial emulator configuration from passed in arguments
+bool set_config_from_args(config_t *config, const int argc, char **argv, 
+                          const frontend_option_t *frontend_options) {
+
+    // Set defaults
+    *config = (config_t){
+        .window_width  = 64,    // CHIP8 original X resolution
+        .window_height = 32,    // CHIP8 original Y resolution
+        .fg_color = 0xFFFFFFFF, // WHITE
+        .bg_color = 0x000000FF, // BLACK
+        .scale_factor = 20,     // Default resolution will be 1280x640
+        .pixel_outlines = true, // Draw pixel "outlines" by default
+        .insts_per_second = 600, // Number of instructions to emulate in 1 second (clock rate of CPU)
+        .square_wave_freq = 440,    // 440hz for middle A
+        .audio_sample_rate = 44100, // CD quality, 44100hz
+        .audio_buffer_samples = 512,    // ~11.6ms at 44100hz
+        .audio_latency_ms = 20,     // Headroom for emulator frame jitter
+        .volume = 3000,             // INT16_MAX would be max volume
+        .color_lerp_rate = 0.7,     // Color lerp rate, between [0.1, 1.0]
+        .current_extension = CHIP8, // Set default quirks/extension to plain OG CHIP-8
+        .keypad_layout = KEYPAD_QWERTY, // Only the 4x4 QWERTY block by default
+        .quirk_db = true,           // Known ROMs get their profile from the quirk database
+        .rom_index = "rom_index.txt",   // ROM hashes/metadata, kept next to where we run
+        .rng_seed = 0,              // Fixed seed, the SDL frontend picks one from the clock
+        .stats_interval_ms = 1000,  // Frame timing stats cover the last second
+        .trace_file = "trace.bin",  // F8 and replay desyncs dump the trace here
+        .threads = 1,               // One ROM at a time
+        // The VIP and HP48 wrap addresses, XO-CHIP ROMs going past 4K want its 64K of RAM
+        .oob_policy = {[CHIP8] = OOB_WRAP, [SUPERCHIP] = OOB_WRAP, [XOCHIP] = OOB_LOG},
+    };
+
+    // Override defaults from passed in arguments. The frontend's own options are skipped 
+    //   over for its own parsing, anything else starting with "--" is a mistake.
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = NULL;
+        uint64_t number;
+
+        if (strcmp(arg, "--help") == 0) {
+            print_config_usage(stdout);
+            exit(EXIT_SUCCESS);
+        }
+
+        // Flags, and their "--no-" forms
+        if (strcmp(arg, "--pixel-outlines") == 0) config->pixel_outlines = true;
+        else if (strcmp(arg, "--no-pixel-outlines") == 0) config->pixel_outlines = false;
+        else if (strcmp(arg, "--quirk-db") == 0) config->quirk_db = true;
+        else if (strcmp(arg, "--no-quirk-db") == 0) config->quirk_db = false;
+        else if (strcmp(arg, "--no-rom-index") == 0) config->rom_index = NULL;
+        else if (strcmp(arg, "--stats-overlay") == 0) config->stats_overlay = true;
+        else if (strcmp(arg, "--no-stats-overlay") == 0) config->stats_overlay = false;
+        else if (strcmp(arg, "--perf") == 0) config->perf_counters = true;
+        else if (strcmp(arg, "--no-perf") == 0) config->perf_counters = false;
+        else if (strcmp(arg, "--turbo") == 0) config->turbo = true;
+        else if (strcmp(arg, "--no-turbo") == 0) config->turbo = false;
+        else if (strcmp(arg, "--vsync") == 0) config->vsync = true;
+        else if (strcmp(arg, "--no-vsync") == 0) config->vsync = false;
+        else if (strcmp(arg, "--headless") == 0) config->headless = true;
+        else if (strcmp(arg, "--no-headless") == 0) config->headless = false;
+        else if (strcmp(arg, "--mute") == 0) config->mute = true;
+        else if (strcmp(arg, "--no-mute") == 0) config->mute = false;
+        else if (strcmp(arg, "--startup-times") == 0) config->startup_times = true;
+        else if (strcmp(arg, "--no-startup-times") == 0) config->startup_times = false;
+
+        // Emulation
+        else if (strcmp(arg, "--ips") == 0) {
+            // At least 1 instruction per frame
+            if (!option_number(argc, argv, &i, 10, 60, UINT32_MAX, &number)) return false;
+            config->insts_per_second = (uint32_t)number;
+            config->given |= GIVEN_IPS;
+        }
+        else if (strcmp(arg, "--quirks") == 0) {
+            // Force a quirks/extension profile, the database can still pick speed and keypad
+            if (!(value = option_value(argc, argv, &i))) return false;
+            if (strcmp(value, "chip8") == 0) config->current_extension = CHIP8;
+            else if (strcmp(value, "superchip") == 0) config->current_extension = SUPERCHIP;
+            else if (strcmp(value, "xochip") == 0) config->current_extension = XOCHIP;
+            else {
+                fprintf(stderr, "Unknown quirks profile %s, expected chip8, superchip or xochip\n", value);
+                return false;
+            }
+            config->given |= GIVEN_QUIRKS;
+        }
+        else if (strcmp(arg, "--oob") == 0) {
+            // Out of range access policy, for all profiles or "profile=policy" for one
+            if (!(value = option_value(argc, argv, &i))) return false;
+            if (!parse_oob_policy(config, value)) return false;
+        }
+        else if (strcmp(arg, "--seed") == 0) {
+            // Seed for CXNN random numbers, the same seed gives the same run
+            if (!option_number(argc, argv, &i, 10, 0, UINT64_MAX, &config->rng_seed)) return false;
+            config->given |= GIVEN_SEED;
+        }
+        else if (strcmp(arg, "--frames") == 0) {
+            if (!option_number(argc, argv, &i, 10, 0, UINT64_MAX, &config->frames)) return false;
+        }
+
+        // Display
+        else if (strcmp(arg, "--scale-factor") == 0) {
+            if (!option_number(argc, argv, &i, 10, 1, 100, &number)) return false;
+            config->scale_factor = (uint32_t)number;
+        }
+        else if (strcmp(arg, "--fg") == 0) {
+            if (!option_number(argc, argv, &i, 16, 0, UINT32_MAX, &number)) return false;
+            config->fg_color = (uint32_t)number;
+        }
+        else if (strcmp(arg, "--bg") == 0) {
+            if (!option_number(argc, argv, &i, 16, 0, UINT32_MAX, &number)) return false;
+            config->bg_color = (uint32_t)number;
+        }
+        else if (strcmp(arg, "--color-lerp") == 0) {
+            if (!option_float(argc, argv, &i, 0.1f, 1.0f, &config->color_lerp_rate)) return false;
+        }
+        else if (strcmp(arg, "--renderer") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->renderer = value;
+        }
+
+        // Audio
+        else if (strcmp(arg, "--volume") == 0) {
+            if (!option_number(argc, argv, &i, 10, 0, INT16_MAX, &number)) return false;
+            config->volume = (int16_t)number;
+        }
+        else if (strcmp(arg, "--square-wave") == 0) {
+            // The synth divides the sample rate by it
+            if (!option_number(argc, argv, &i, 10, 1, 20000, &number)) return false;
+            config->square_wave_freq = (uint32_t)number;
+        }
+        else if (strcmp(arg, "--sample-rate") == 0) {
+            // Audio sample rate, for the audio device or offline rendering
+            if (!option_number(argc, argv, &i, 10, 8000, 192000, &number)) return false;
+            config->audio_sample_rate = (uint32_t)number;
+        }
+        else if (strcmp(arg, "--audio-buffer") == 0) {
+            // Audio device buffer size in samples, smaller is lower latency
+            if (!option_number(argc, argv, &i, 10, 16, 32768, &number)) return false;
+            config->audio_buffer_samples = (uint16_t)number;
+        }
+        else if (strcmp(arg, "--audio-latency") == 0) {
+            // Delay applied to sound events before playback
+            if (!option_number(argc, argv, &i, 10, 0, 1000, &number)) return false;
+            config->audio_latency_ms = (uint32_t)number;
+        }
+
+        // Capture
+        else if (strcmp(arg, "--record") == 0) {
+            // Record keypad input to a movie file, for replaying with the headless runner
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->record_movie = value;
+        }
+        else if (strcmp(arg, "--wav") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->wav_file = value;
+        }
+        else if (strcmp(arg, "--sound-bitmap") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->sound_bits_file = value;
+        }
+        else if (strcmp(arg, "--trace-file") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->trace_file = value;
+        }
+        else if (strcmp(arg, "--stats-file") == 0) {
+            // Frame timing stats, written to a file and/or drawn over the display
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->stats_file = value;
+        }
+        else if (strcmp(arg, "--stats-interval") == 0) {
+            if (!option_number(argc, argv, &i, 10, 1, 3600000, &number)) return false;
+            config->stats_interval_ms = (uint32_t)number;
+        }
+
+        // Host
+        else if (strcmp(arg, "--threads") == 0) {
+            if (!option_number(argc, argv, &i, 10, 1, 1024, &number)) return false;
+            config->threads = (uint32_t)number;
+        }
+
+        else if (strcmp(arg, "--rom-index") == 0) {
+            // ROM library index file
+            if (!(value = option_value(argc, argv, &i))) return false;
+            config->rom_index = value;
+        }
+
+        // Already read by expand_config_file
+        else if (strcmp(arg, "--config") == 0 || strcmp(arg, "--profile") == 0) i++;
+
+        else if (strncmp(arg, "--", 2) == 0) {
+            const frontend_option_t *option = frontend_options;
+            while (option && option->name && strcmp(arg, option->name) != 0) option++;
+            if (!option || !option->name) {
+                fprintf(stderr, "Unknown option %s, --help lists them\n", arg);
+                return false;
+            }
+            if (option->has_value && !option_value(argc, argv, &i)) return false;
+        }
+    }
+
+    if (config->mute) config->volume = 0;
+
+    return true;    // Success
+}
+
+// s trimmed of whitespace at both ends, in place
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) 
+        *--end = '\0';
+    return s;
+}
+
+// Add the options from one [section] of a config file to args, returns false if the 
+//   section isn't in the file
+static bool read_config_section(const char *text, const char *section, char **args, int *count) {
+    char *copy = strdup(text);  // Kept, args point into it
+    bool in_section = false, found = false;
+
+    for (char *line = strtok(copy, "\n"); line; line = strtok(NULL, "\n")) {
+        line = trim(line);
+        if (*line == '\0' || *line == '#' || *line == ';') continue;
+
+        if (*line == '[') {
+            char *close = strchr(line, ']');
+            if (close) *close = '\0';
+            in_section = strcmp(line + 1, section) == 0;
+            found |= in_section;
+            continue;
+        }
+        if (!in_section) continue;
+
+        // "option = value", "option = true/false" or just "option"
+        char *value = strchr(line, '=');
+        if (value) {
+            *value++ = '\0';
+            value = trim(value);
+        }
+        char *name = trim(line);
+        if (strncmp(name, "--", 2) == 0) name += 2;
+
+        char *option = malloc(strlen(name) + 6);
+        if (value && strcmp(value, "false") == 0) sprintf(option, "--no-%s", name);
+        else sprintf(option, "--%s", name);
+        args[(*count)++] = option;
+        if (value && *value && strcmp(value, "true") != 0 && strcmp(value, "false") != 0) 
+            args[(*count)++] = value;
+    }
+
+    return found;
+}
+
+// Put the options from --config FILE in front of the command line ones in *argv, so the 
+//   command line wins. The file is "option = value" lines (option names without "--") in 
+//   [sections]: [default] always applies, and --profile NAME applies [NAME] on top of it.
+//   "option = true/false" turns a flag on/off. The new argv lives for the whole program.
+bool expand_config_file(int *argc, char ***argv) {
+    const char *file_name = NULL, *profile = NULL;
+    for (int i = 1; i + 1 < *argc; i++) {
+        if (strcmp((*argv)[i], "--config") == 0) file_name = (*argv)[i + 1];
+        if (strcmp((*argv)[i], "--profile") == 0) profile = (*argv)[i + 1];
+    }
+    if (!file_name) {
+        if (profile) fprintf(stderr, "--profile needs a --config file\n");
+        return !profile;
+    }
+
+    FILE *file = fopen(file_name, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open config file %s\n", file_name);
+        return false;
+    }
+    static char text[64 * 1024];
+    const size_t size = fread(text, 1, sizeof text - 1, file);
+    fclose(file);
+    text[size] = '\0';
+
+    // Every line gives at most 2 args
+    int lines = 1;
+    for (size_t i = 0; i < size; i++) lines += text[i] == '\n';
+    char **args = malloc(sizeof(char *) * (2 * lines * 2 + *argc + 1));
+    if (!args) return false;
+
+    int count = 0;
+    args[count++] = (*argv)[0];
+    read_config_section(text, "default", args, &count);
+    if (profile && !read_config_section(text, profile, args, &count)) {
+        fprintf(stderr, "No [%s] profile in %s\n", profile, file_name);
+        free(args);
+        return false;
+    }
+
+    for (int i = 1; i < *argc; i++) args[count++] = (*argv)[i];
+    args[count] = NULL;
+
+    *argc = count;
+    *argv = args;
+    return true;
+}
+
+// FNV-1a hash, used to tie save states to the ROM they were made with
+uint32_t fnv1a_hash(const uint8_t *data, const size_t size) {
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Color "lerp" helper function
+uint32_t color_lerp(const uint32_t start_color, const uint32_t end_color, const float t) {
+    const uint8_t s_r = (start_color >> 24) & 0xFF;
+    const uint8_t s_g = (start_color >> 16) & 0xFF;
+    const uint8_t s_b = (start_color >>  8) & 0xFF;
+    const uint8_t s_a = (start_color >>  0) & 0xFF;
+
+    const uint8_t e_r = (end_color >> 24) & 0xFF;
+    const uint8_t e_g = (end_color >> 16) & 0xFF;
+    const uint8_t e_b = (end_color >>  8) & 0xFF;
+    const uint8_t e_a = (end_color >>  0) & 0xFF;
+
+    const uint8_t ret_r = ((1-t)*s_r) + (t*e_r);
+    const uint8_t ret_g = ((1-t)*s_g) + (t*e_g);
+    const uint8_t ret_b = ((1-t)*s_b) + (t*e_b);
+    const uint8_t ret_a = ((1-t)*s_a) + (t*e_a);
+
+    return (ret_r << 24) | (ret_g << 16) | (ret_b << 8) | ret_a;
+}
+
+// Initialize CHIP8 machine, from the already loaded ROM so resetting never touches the disk
+bool init_chip8(chip8_t *chip8, const config_t config, const rom_t *rom) {
+    // Initialize entire CHIP8 machine
+    memset(chip8, 0, sizeof(chip8_t));
+
+    // Load font and ROM 
+    memcpy(&chip8->ram[0], rom->image, CHIP8_RAM_SIZE);
+    sync_ram_guard(chip8);
+
+    // Set chip8 machine defaults
+    chip8->state = RUNNING;     // Default machine state to on/running
+    chip8->PC = CHIP8_ENTRY_POINT;  // Start program counter at ROM entry point
+    chip8->rom = rom;
+    chip8->rng = config.rng_seed;   // Every machine has its own random numbers
+    chip8->wait_key = 0xFF;     // FX0A not waiting on a key
+    memset(&chip8->pixel_color[0], config.bg_color, sizeof chip8->pixel_color); // Init pixels to bg color
+
+    return true;    // Success
+}
+
+void sync_ram_guard(chip8_t *chip8) {
+    memcpy(&chip8->ram[CHIP8_RAM_SIZE], &chip8->ram[0], CHIP8_RAM_GUARD);
+    chip8->dirty_pages = CHIP8_ALL_PAGES;   // No telling what was written, clones copy it all
+}
+
+// Mark the RAM pages holding first..last written, for clones. The range is never longer 
+//   than a page, so its ends cover it even when it wraps.
+static inline void mark_pages_dirty(chip8_t *chip8, const uint32_t first, const uint32_t last) {
+    chip8->dirty_pages |= (1u << ((first & CHIP8_RAM_MASK) / CHIP8_PAGE_SIZE)) |
+                          (1u << ((last & CHIP8_RAM_MASK) / CHIP8_PAGE_SIZE));
+}
+
+#ifdef DEBUG
+void print_debug_info(chip8_t *chip8) {
+    trace_entry_t entry;
+    char desc[TRACE_DESC_SIZE];
+
+    trace_capture(chip8, &entry);
+    describe_instruction(&entry, desc, sizeof desc);
+    printf("Address: 0x%04X, Opcode: 0x%04X Desc: %s\n", entry.PC, entry.opcode, desc);
+}
+#endif
+
+// Next random byte from the machine's own generator, SplitMix64. Every state is valid,
+//   including 0, so any seed works.
+static inline uint8_t random_byte(chip8_t *chip8) {
+    uint64_t z = (chip8->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (z ^ (z >> 31)) >> 56;
+}
+
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+// Out of range accesses in RAM, the stack or the keypad wrap with a mask, no branches. 
+//   Each instruction that can make one also ORs a FAULT_* bit into chip8->fault, once 
+//   per instruction rather than per byte, and the quirks profile's policy for it is 
+//   applied once a frame.
+
+// Emulate 1 CHIP8 instruction. Inlined into a normal and a debug core, with debug a 
+//   constant the debugger checks compile away entirely in the normal one.
+static ALWAYS_INLINE bool execute_instruction(chip8_t *chip8, const config_t config, const bool debug) {
+    bool carry;   // Save carry flag/VF value for some instructions
+
+    if (debug && !debugger_before(config.debugger, chip8)) return false;
+
+    // Get next opcode from ram. Running off the end of RAM wraps to 0 like the VIP, and 
+    //   PC + 1 at the end of RAM is the first guard byte.
+    const uint16_t PC = chip8->PC & CHIP8_RAM_MASK;
+    chip8->inst.opcode = (chip8->ram[PC] << 8) | chip8->ram[PC + 1];
+    chip8->PC = PC + 2; // Pre-increment program counter for next opcode
+
+    // Fill out current instruction format
+    chip8->inst.NNN = chip8->inst.opcode & 0x0FFF;
+    chip8->inst.NN = chip8->inst.opcode & 0x0FF;
+    chip8->inst.N = chip8->inst.opcode & 0x0F;
+    chip8->inst.X = (chip8->inst.opcode >> 8) & 0x0F;
+    chip8->inst.Y = (chip8->inst.opcode >> 4) & 0x0F;
+
+#ifdef DEBUG
+    print_debug_info(chip8);
+#endif
+
+#ifdef TRACE
+    if (config.trace) trace_record(config.trace, chip8);
+#endif
+
+#ifdef PROFILE
+    if (config.profile) profile_instruction(config.profile, chip8->PC - 2, chip8->inst.opcode);
+#endif
+
+    // Emulate opcode
+    switch ((chip8->inst.opcode >> 12) & 0x0F) {
+        case 0x00:
+            if (chip8->inst.NN == 0xE0) {
+                // 0x00E0: Clear the screen
+                memset(&chip8->display[0], false, sizeof chip8->display);
+                chip8->draw = true; // Will update screen on next 60hz tick
+
+            } else if (chip8->inst.NN == 0xEE) {
+                // 0x00EE: Return from subroutine
+                // Set program counter to last address on subroutine stack ("pop" it off the stack)
+                //   so that next opcode will be gotten from that address. Popping an empty 
+                //   stack wraps around to the top entry.
+                chip8->fault |= (chip8->SP == 0) * FAULT_STACK;
+                chip8->SP = (chip8->SP + CHIP8_STACK_SIZE - 1) % CHIP8_STACK_SIZE;
+                chip8->PC = chip8->stack[chip8->SP];
+
+            } else {
+                // Unimplemented/invalid opcode, may be 0xNNN for calling machine code routine for RCA1802
+            }
+
+            break;
+
+        case 0x01:
+            // 0x1NNN: Jump to address NNN
+            chip8->PC = chip8->inst.NNN;    // Set program counter so that next opcode is from NNN
+            break;
+
+        case 0x02:
+            // 0x2NNN: Call subroutine at NNN
+            // Store current address to return to on subroutine stack ("push" it on the stack)
+            //   and set program counter to subroutine address so that the next opcode
+            //   is gotten from there. Pushing onto a full stack wraps around to the bottom 
+            //   entry, SP stays 0-12 so it always fits a save state.
+            chip8->fault |= (chip8->SP >= CHIP8_STACK_SIZE) * FAULT_STACK;
+            chip8->stack[chip8->SP % CHIP8_STACK_SIZE] = chip8->PC;  
+            chip8->SP = chip8->SP % CHIP8_STACK_SIZE + 1;
+            chip8->PC = chip8->inst.NNN;
+            break;
+
+        case 0x03:
+            // 0x3XNN: Check if VX == NN, if so, skip the next instruction
+            if (chip8->V[chip8->inst.X] == chip8->inst.NN)
+                chip8->PC += 2;       // Skip next opcode/instruction
+            break;
+
+        case 0x04:
+            // 0x4XNN: Check if VX != NN, if so, skip the next instruction
+            if (chip8->V[chip8->inst.X] != chip8->inst.NN)
+                chip8->PC += 2;       // Skip next opcode/instruction
+            break;
+
+        case 0x05:
+            // 0x5XY0: Check if VX == VY, if so, skip the next instruction
+            if (chip8->inst.N != 0) break; // Wrong opcode
+
+            if (chip8->V[chip8->inst.X] == chip8->V[chip8->inst.Y])
+                chip8->PC += 2;       // Skip next opcode/instruction
+            
+            break;
+
+        case 0x06:
+            // 0x6XNN: Set register VX to NN
+            chip8->V[chip8->inst.X] = chip8->inst.NN;
+            break;
+
+        case 0x07:
+            // 0x7XNN: Set register VX += NN
+            chip8->V[chip8->inst.X] += chip8->inst.NN;
+            break;
+
+        case 0x08:
+            switch(chip8->inst.N) {
+                case 0:
+                    // 0x8XY0: Set register VX = VY
+                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y];
+                    break;
+
+                case 1:
+                    // 0x8XY1: Set register VX |= VY
+                    chip8->V[chip8->inst.X] |= chip8->V[chip8->inst.Y];
+                    if (config.current_extension == CHIP8)
+                        chip8->V[0xF] = 0;  // Reset VF to 0
+                    break;
+
+                case 2:
+                    // 0x8XY2: Set register VX &= VY
+                    chip8->V[chip8->inst.X] &= chip8->V[chip8->inst.Y];
+                    if (config.current_extension == CHIP8)
+                        chip8->V[0xF] = 0;  // Reset VF to 0
+                    break;
+
+                case 3:
+                    // 0x8XY3: Set register VX ^= VY
+                    chip8->V[chip8->inst.X] ^= chip8->V[chip8->inst.Y];
+                    if (config.current_extension == CHIP8)
+                        chip8->V[0xF] = 0;  // Reset VF to 0
+                    break;
+
+                case 4:
+                    // 0x8XY4: Set register VX += VY, set VF to 1 if carry, 0 if not 
+                    carry = ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255);
+
+                    chip8->V[chip8->inst.X] += chip8->V[chip8->inst.Y];
+                    chip8->V[0xF] = carry; 
+                    break;
+
+                case 5: 
+                    // 0x8XY5: Set register VX -= VY, set VF to 1 if there is not a borrow (result is positive/0)
+                    carry = (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]);
+
+                    chip8->V[chip8->inst.X] -= chip8->V[chip8->inst.Y];
+                    chip8->V[0xF] = carry;
+                    break;
+
+                case 6:
+                    // 0x8XY6: Set register VX >>= 1, store shifted off bit in VF
+                    if (config.current_extension == CHIP8) {
+                        carry = chip8->V[chip8->inst.Y] & 1;    // Use VY
+                        chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] >> 1; // Set VX = VY result
+                    } else {
+                        carry = chip8->V[chip8->inst.X] & 1;    // Use VX
+                        chip8->V[chip8->inst.X] >>= 1;          // Use VX
+                    }
+
+                    chip8->V[0xF] = carry;
+                    break;
+
+                case 7:
+                    // 0x8XY7: Set register VX = VY - VX, set VF to 1 if there is not a borrow (result is positive/0)
+                    carry = (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]);
+
+                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X];
+                    chip8->V[0xF] = carry;
+                    break;
+
+                case 0xE:
+                    // 0x8XYE: Set register VX <<= 1, store shifted off bit in VF
+                    if (config.current_extension == CHIP8) { 
+                        carry = (chip8->V[chip8->inst.Y] & 0x80) >> 7; // Use VY
+                        chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] << 1; // Set VX = VY result
+                    } else {
+                        carry = (chip8->V[chip8->inst.X] & 0x80) >> 7;  // VX
+                        chip8->V[chip8->inst.X] <<= 1;                  // Use VX
+                    }
+
+                    chip8->V[0xF] = carry;
+                    break;
+
+                default:
+                    // Wrong/unimplemented opcode
+                    break;
+            }
+            break;
+
+        case 0x09:
+            // 0x9XY0: Check if VX != VY; Skip next instruction if so
+            if (chip8->V[chip8->inst.X] != chip8->V[chip8->inst.Y])
+                chip8->PC += 2;
+            break;
+
+        case 0x0A:
+            // 0xANNN: Set index register I to NNN
+            chip8->I = chip8->inst.NNN;
+            break;
+
+        case 0x0B:
+            // 0xBNNN: Jump to V0 + NNN
+            chip8->PC = chip8->V[0] + chip8->inst.NNN;
+            chip8->fault |= (chip8->PC > CHIP8_RAM_MASK) * FAULT_RAM;
+            break;
+
+        case 0x0C:
+            // 0xCXNN: Sets register VX = random byte & NN (bitwise AND)
+            chip8->V[chip8->inst.X] = random_byte(chip8) & chip8->inst.NN;
+            break;
+
+        case 0x0D: {
+            // 0xDXYN: Draw N-height sprite at coords X,Y; Read from memory location I;
+            //   Screen pixels are XOR'd with sprite bits, 
+            //   VF (Carry flag) is set if any screen pixels are set off; This is useful
+            //   for collision detection or other reasons.
+            uint8_t X_coord = chip8->V[chip8->inst.X] % config.window_width;
+            uint8_t Y_coord = chip8->V[chip8->inst.Y] % config.window_height;
+            const uint8_t orig_X = X_coord; // Original X value
+
+            chip8->V[0xF] = 0;  // Initialize carry flag to 0
+
+            // Up to 15 rows from I, the guard bytes keep a sprite running off the end of RAM 
+            //   inside it and wrap it to the start
+            chip8->fault |= (chip8->I + chip8->inst.N > CHIP8_RAM_SIZE) * FAULT_RAM;
+            const uint16_t sprite_addr = chip8->I & CHIP8_RAM_MASK;
+            const uint8_t *sprite = &chip8->ram[sprite_addr];
+
+            // Loop over all N rows of the sprite
+            for (uint8_t i = 0; i < chip8->inst.N; i++) {
+                // Get next byte/row of sprite data
+                const uint8_t sprite_data = sprite[i];
+                if (debug) debugger_read(config.debugger, (sprite_addr + i) & CHIP8_RAM_MASK);
+                X_coord = orig_X;   // Reset X for next row to draw
+
+                for (int8_t j = 7; j >= 0; j--) {
+                    // If sprite pixel/bit is on and display pixel is on, set carry flag
+                    bool *pixel = &chip8->display[Y_coord * config.window_width + X_coord]; 
+                    const bool sprite_bit = (sprite_data & (1 << j));
+
+                    if (sprite_bit && *pixel) {
+                        chip8->V[0xF] = 1;  
+                    }
+
+                    // XOR display pixel with sprite pixel/bit to set it on or off
+                    *pixel ^= sprite_bit;
+
+                    // Stop drawing this row if hit right edge of screen
+                    if (++X_coord >= config.window_width) break;
+                }
+
+                // Stop drawing entire sprite if hit bottom edge of screen
+                if (++Y_coord >= config.window_height) break;
+            }
+            chip8->draw = true; // Will update screen on next 60hz tick
+            break;
+        }
+
+        case 0x0E:
+            if (chip8->inst.NN == 0x9E) {
+                // 0xEX9E: Skip next instruction if key in VX is pressed, only the low 4 bits 
+                //   of VX pick the key
+                chip8->fault |= (chip8->V[chip8->inst.X] > 0xF) * FAULT_KEYPAD;
+                if (chip8->keypad[chip8->V[chip8->inst.X] & 0xF])
+                    chip8->PC += 2;
+
+            } else if (chip8->inst.NN == 0xA1) {
+                // 0xEXA1: Skip next instruction if key in VX is not pressed
+                chip8->fault |= (chip8->V[chip8->inst.X] > 0xF) * FAULT_KEYPAD;
+                if (!chip8->keypad[chip8->V[chip8->inst.X] & 0xF])
+                    chip8->PC += 2;
+            }
+            break;
+
+        case 0x0F:
+            switch (chip8->inst.NN) {
+                case 0x0A: {
+                    // 0xFX0A: VX = get_key(); Await until a keypress, and store in VX
+                    //   The key being waited on lives in the machine, so it's per instance and saved
+                    for (uint8_t i = 0; chip8->wait_key == 0xFF && i < sizeof chip8->keypad; i++) 
+                        if (chip8->keypad[i]) {
+                            chip8->wait_key = i;    // Save pressed key to check until it is released
+                            break;
+                        }
+
+                    // If no key has been pressed yet, keep getting the current opcode & running this instruction
+                    if (chip8->wait_key == 0xFF) chip8->PC -= 2; 
+                    else {
+                        // A key has been pressed, also wait until it is released to set the key in VX
+                        if (chip8->keypad[chip8->wait_key])     // "Busy loop" CHIP8 emulation until key is released
+                            chip8->PC -= 2;
+                        else {
+                            chip8->V[chip8->inst.X] = chip8->wait_key;  // VX = key 
+                            chip8->wait_key = 0xFF;                     // Reset key to not found 
+                        }
+                    }
+                    break;
+                }
+
+                case 0x1E:
+                    // 0xFX1E: I += VX; Add VX to register I. For non-Amiga CHIP8, does not affect VF
+                    chip8->I += chip8->V[chip8->inst.X];
+                    break;
+
+                case 0x07:
+                    // 0xFX07: VX = delay timer
+                    chip8->V[chip8->inst.X] = chip8->delay_timer;
+                    break;
+
+                case 0x15:
+                    // 0xFX15: delay timer = VX 
+                    chip8->delay_timer = chip8->V[chip8->inst.X];
+                    break;
+
+                case 0x18:
+                    // 0xFX18: sound timer = VX 
+                    chip8->sound_timer = chip8->V[chip8->inst.X];
+                    break;
+
+                case 0x29:
+                    // 0xFX29: Set register I to sprite location in memory for character in VX (0x0-0xF)
+                    chip8->I = chip8->V[chip8->inst.X] * 5;
+                    break;
+
+                case 0x33: {
+                    // 0xFX33: Store BCD representation of VX at memory offset from I;
+                    //   I = hundred's place, I+1 = ten's place, I+2 = one's place
+                    uint8_t bcd = chip8->V[chip8->inst.X]; 
+                    chip8->fault |= (chip8->I + 2 > CHIP8_RAM_MASK) * FAULT_RAM;
+                    mark_pages_dirty(chip8, chip8->I, chip8->I + 2);
+                    if (debug) 
+                        for (uint8_t i = 0; i < 3; i++) 
+                            debugger_write(config.debugger, (chip8->I + i) & CHIP8_RAM_MASK);
+                    chip8->ram[(chip8->I + 2) & CHIP8_RAM_MASK] = bcd % 10;
+                    bcd /= 10;
+                    chip8->ram[(chip8->I + 1) & CHIP8_RAM_MASK] = bcd % 10;
+                    bcd /= 10;
+                    chip8->ram[chip8->I & CHIP8_RAM_MASK] = bcd;
+
+                    // Keep the guard bytes a copy of the start of RAM, copying them is 
+                    //   cheaper than checking whether the write landed there
+                    memcpy(&chip8->ram[CHIP8_RAM_SIZE], &chip8->ram[0], CHIP8_RAM_GUARD);
+                    break;
+                }
+
+                case 0x55:
+                    // 0xFX55: Register dump V0-VX inclusive to memory offset from I;
+                    //   SCHIP does not increment I, CHIP8 does increment I
+                    chip8->fault |= (chip8->I + chip8->inst.X > CHIP8_RAM_MASK) * FAULT_RAM;
+                    mark_pages_dirty(chip8, chip8->I, chip8->I + chip8->inst.X);
+                    for (uint8_t i = 0; i <= chip8->inst.X; i++)  {
+                        if (debug) 
+                            debugger_write(config.debugger, 
+                                           (chip8->I + (config.current_extension == CHIP8 ? 0 : i)) & CHIP8_RAM_MASK);
+                        if (config.current_extension == CHIP8) 
+                            chip8->ram[chip8->I++ & CHIP8_RAM_MASK] = chip8->V[i]; // Increment I each time
+                        else
+                            chip8->ram[(chip8->I + i) & CHIP8_RAM_MASK] = chip8->V[i]; 
+                    }
+                    memcpy(&chip8->ram[CHIP8_RAM_SIZE], &chip8->ram[0], CHIP8_RAM_GUARD);
+                    break;
+
+                case 0x65:
+                    // 0xFX65: Register load V0-VX inclusive from memory offset from I;
+                    //   SCHIP does not increment I, CHIP8 does increment I
+                    chip8->fault |= (chip8->I + chip8->inst.X > CHIP8_RAM_MASK) * FAULT_RAM;
+                    for (uint8_t i = 0; i <= chip8->inst.X; i++) {
+                        if (debug) 
+                            debugger_read(config.debugger, 
+                                          (chip8->I + (config.current_extension == CHIP8 ? 0 : i)) & CHIP8_RAM_MASK);
+                        if (config.current_extension == CHIP8) 
+                            chip8->V[i] = chip8->ram[chip8->I++ & CHIP8_RAM_MASK]; // Increment I each time
+                        else
+                            chip8->V[i] = chip8->ram[(chip8->I + i) & CHIP8_RAM_MASK];
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+            
+        default:
+            break;  // Unimplemented or invalid opcode
+    }
+
+    if (debug) return debugger_after(config.debugger, chip8);
+    return true;
+}
+
+// Emulate 1 CHIP8 instruction
+void emulate_instruction(chip8_t *chip8, const config_t config) {
+    execute_instruction(chip8, config, false);
+}
+
+// Emulate 1 CHIP8 instruction under the debugger
+bool emulate_instruction_debug(chip8_t *chip8, const config_t config) {
+    return execute_instruction(chip8, config, true);
+}
+
+// Update CHIP8 delay and sound timers every 60hz
+void update_timers(chip8_t *chip8) {
+    if (chip8->delay_timer > 0) 
+        chip8->delay_timer--;
+
+    if (chip8->sound_timer > 0) 
+        chip8->sound_timer--;
+}
+
+// Run 1 frame's worth of instructions, returns how many ran. Inlined once per core so 
+//   the debug check is made per frame, not per instruction.
+static ALWAYS_INLINE uint32_t run_instructions(chip8_t *chip8, const config_t config, 
+                                               audio_t *audio, const bool debug) {
+    const uint32_t insts_per_frame = config.insts_per_second / 60;
+    uint32_t i = 0;
+
+    while (i < insts_per_frame) {
+        // A debugger hit pauses the machine, the rest of the frame (timers) still runs
+        if (!execute_instruction(chip8, config, debug)) {
+            if (config.debugger->hit) i++;  // Watchpoints/conditions pause after the instruction ran
+            break;
+        }
+        i++;
+
+        // Start the tone at the sample matching this instruction's position in the frame
+        if (audio && chip8->sound_timer && !audio->sound_on)
+            audio_set_sound(audio, config, true, i * (config.audio_sample_rate / 60) / insts_per_frame);
+
+        // If drawing on CHIP8, only draw 1 sprite this frame (display wait)
+        if ((config.current_extension == CHIP8) && 
+            (chip8->inst.opcode >> 12 == 0xD)) 
+            break;  
+    }
+
+    return i;
+}
+
+// Apply the quirks profile's policy to the out of range accesses made this frame
+static void handle_fault(chip8_t *chip8, const config_t config) {
+    const oob_policy_t policy = config.oob_policy[config.current_extension];
+    const uint8_t fault = chip8->fault;
+    chip8->fault = 0;
+    if (policy == OOB_WRAP || (policy == OOB_LOG && !(fault & ~chip8->faults_logged))) return;
+
+    char what[48];
+    snprintf(what, sizeof what, "out of range%s%s%s", fault & FAULT_RAM ? " RAM" : "", 
+             fault & FAULT_STACK ? " stack" : "", fault & FAULT_KEYPAD ? " keypad" : "");
+    fprintf(stderr, "%s: %s access, PC 0x%03X I 0x%03X SP %u\n", chip8->rom->name, what, 
+            chip8->PC, chip8->I, chip8->SP);
+    chip8->faults_logged |= fault;
+
+    if (policy == OOB_TRAP) {
+        chip8->state = PAUSED;
+        if (config.debugger) {
+            snprintf(config.debugger->reason, sizeof config.debugger->reason, "%s", what);
+            config.debugger->inst_pc = chip8->PC;
+        }
+    }
+}
+
+// Emulate 1 60hz frame of instructions and tick the timers
+uint32_t emulate_frame(chip8_t *chip8, const config_t config, audio_t *audio) {
+#ifdef PROFILE
+    const uint64_t start_ns = monotonic_ns();
+#endif
+
+    // Swap in the instrumented core only while something is being watched
+    const uint32_t i = config.debugger && config.debugger->active ?
+        run_instructions(chip8, config, audio, true) : 
+        run_instructions(chip8, config, audio, false);
+
+    if (config.telemetry) telemetry_mark(config.telemetry, PHASE_EMULATE);
+
+    update_timers(chip8);
+
+    if (chip8->fault) handle_fault(chip8, config);
+
+    // Sound plays until the end of the frame the sound timer runs out in
+    if (audio) {
+        audio->frame_sound_on = audio->sound_on;
+        audio_set_sound(audio, config, chip8->sound_timer > 0, config.audio_sample_rate / 60);
+        audio_end_frame(audio, config);
+    }
+
+    if (config.telemetry) telemetry_mark(config.telemetry, PHASE_TIMERS);
+
+#ifdef PROFILE
+    if (config.profile) profile_frame(config.profile, i, monotonic_ns() - start_ns);
+#endif
+
+    return i;
+}
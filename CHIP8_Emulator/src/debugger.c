@@ -0,0 +1,192 @@
+#include <ctype.h>
+
+#include "debugger.h"
+
+static const char *op_names[] = {"==", "!=", "<", "<=", ">", ">="};
+
+// Parse an address argument, decimal or 0x hex, that must fit in RAM
+static bool parse_address(const char *text, uint16_t *addr) {
+    char *end;
+    const long value = strtol(text, &end, 0);
+    if (end == text || *end || value < 0 || value > 0xFFF) {
+        fprintf(stderr, "Bad debugger address %s, expected 0x000-0xFFF\n", text);
+        return false;
+    }
+    *addr = (uint16_t)value;
+    return true;
+}
+
+void debugger_set_breakpoint(debugger_t *debugger, const uint16_t addr) {
+    if (!debugger_bit(debugger->breakpoints, addr)) debugger->active++;
+    debugger->breakpoints[(addr & 0xFFF) >> 3] |= 1 << (addr & 7);
+}
+
+void debugger_set_watch(debugger_t *debugger, const uint16_t addr, const bool read, const bool write) {
+    if (read && !debugger_bit(debugger->read_watch, addr)) {
+        debugger->read_watch[(addr & 0xFFF) >> 3] |= 1 << (addr & 7);
+        debugger->active++;
+    }
+    if (write && !debugger_bit(debugger->write_watch, addr)) {
+        debugger->write_watch[(addr & 0xFFF) >> 3] |= 1 << (addr & 7);
+        debugger->active++;
+    }
+}
+
+bool debugger_add_condition(debugger_t *debugger, const char *text) {
+    if (debugger->condition_count == DEBUGGER_CONDITIONS) {
+        fprintf(stderr, "Too many debugger conditions, at most %d\n", DEBUGGER_CONDITIONS);
+        return false;
+    }
+
+    debug_condition_t cond = {.text = text};
+    const char *p = text;
+
+    // Register: V0-VF, I, SP, DT or ST
+    if (toupper(p[0]) == 'V' && isxdigit(p[1])) {
+        cond.reg = COND_V0 + (isdigit(p[1]) ? p[1] - '0' : toupper(p[1]) - 'A' + 10);
+        p += 2;
+    } else if (strncmp(p, "SP", 2) == 0) { cond.reg = COND_SP; p += 2; }
+    else if (strncmp(p, "DT", 2) == 0) { cond.reg = COND_DT; p += 2; }
+    else if (strncmp(p, "ST", 2) == 0) { cond.reg = COND_ST; p += 2; }
+    else if (p[0] == 'I') { cond.reg = COND_I; p += 1; }
+    else goto bad;
+
+    // Operator, 2 character ones first so "<=" isn't read as "<"
+    bool found = false;
+    for (int len = 2; len >= 1 && !found; len--)
+        for (condition_op_t op = COND_EQ; op <= COND_GE; op++)
+            if (strlen(op_names[op]) == (size_t)len && strncmp(p, op_names[op], len) == 0) {
+                cond.op = op;
+                p += len;
+                found = true;
+                break;
+            }
+    if (!found) goto bad;
+
+    char *end;
+    const long value = strtol(p, &end, 0);
+    if (end == p || *end || value < 0 || value > 0xFFFF) goto bad;
+    cond.value = (uint16_t)value;
+
+    debugger->conditions[debugger->condition_count++] = cond;
+    debugger->active++;
+    return true;
+
+bad:
+    fprintf(stderr, "Bad debugger condition %s, expected e.g. V3==5 or I>=0x300\n", text);
+    return false;
+}
+
+bool debugger_from_args(debugger_t *debugger, const int argc, char **argv) {
+    memset(debugger, 0, sizeof *debugger);
+    debugger->resume_pc = 0xFFFF;   // No breakpoint to skip
+
+    for (int i = 1; i < argc; i++) {
+        const bool breakpoint = strcmp(argv[i], "--break-pc") == 0 || 
+                                strcmp(argv[i], "--break-read") == 0 ||
+                                strcmp(argv[i], "--break-write") == 0 || 
+                                strcmp(argv[i], "--break-if") == 0;
+        if (!breakpoint) continue;
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        const char *option = argv[i], *value = argv[++i];
+        uint16_t addr;
+
+        // Break before executing the instruction at an address
+        if (strcmp(option, "--break-pc") == 0) {
+            if (!parse_address(value, &addr)) return false;
+            debugger_set_breakpoint(debugger, addr);
+        }
+
+        // Break after an instruction reads or writes an address
+        else if (strcmp(option, "--break-read") == 0) {
+            if (!parse_address(value, &addr)) return false;
+            debugger_set_watch(debugger, addr, true, false);
+        }
+        else if (strcmp(option, "--break-write") == 0) {
+            if (!parse_address(value, &addr)) return false;
+            debugger_set_watch(debugger, addr, false, true);
+        }
+
+        // Break when a register condition becomes true
+        else if (!debugger_add_condition(debugger, value)) return false;
+    }
+
+    return true;    // Success
+}
+
+static uint16_t condition_value(const chip8_t *chip8, const condition_reg_t reg) {
+    switch (reg) {
+        case COND_I:  return chip8->I;
+        case COND_SP: return chip8->SP;
+        case COND_DT: return chip8->delay_timer;
+        case COND_ST: return chip8->sound_timer;
+        default:      return chip8->V[reg - COND_V0];
+    }
+}
+
+static bool condition_true(const debug_condition_t *cond, const chip8_t *chip8) {
+    const uint16_t value = condition_value(chip8, cond->reg);
+    switch (cond->op) {
+        case COND_EQ: return value == cond->value;
+        case COND_NE: return value != cond->value;
+        case COND_LT: return value < cond->value;
+        case COND_LE: return value <= cond->value;
+        case COND_GT: return value > cond->value;
+        default:      return value >= cond->value;
+    }
+}
+
+bool debugger_before(debugger_t *debugger, chip8_t *chip8) {
+    debugger->inst_pc = chip8->PC;
+    debugger->hit = false;
+
+    // Resuming from a breakpoint runs the instruction it stopped on
+    if (chip8->PC == debugger->resume_pc) {
+        debugger->resume_pc = 0xFFFF;
+        return true;
+    }
+    debugger->resume_pc = 0xFFFF;
+
+    if (!debugger_bit(debugger->breakpoints, chip8->PC)) return true;
+
+    snprintf(debugger->reason, sizeof debugger->reason, "breakpoint at 0x%03X", chip8->PC);
+    debugger->resume_pc = chip8->PC;
+    chip8->state = PAUSED;
+    return false;
+}
+
+bool debugger_after(debugger_t *debugger, chip8_t *chip8) {
+    for (uint8_t i = 0; i < debugger->condition_count; i++) {
+        debug_condition_t *cond = &debugger->conditions[i];
+        const bool now_true = condition_true(cond, chip8);
+
+        if (now_true && !cond->was_true && !debugger->hit) {
+            debugger->hit = true;
+            snprintf(debugger->reason, sizeof debugger->reason, "%s", cond->text);
+        }
+        cond->was_true = now_true;
+    }
+
+    if (!debugger->hit) return true;
+
+    chip8->state = PAUSED;
+    return false;
+}
+
+void debugger_step(debugger_t *debugger, chip8_t *chip8, const config_t config) {
+    snprintf(debugger->reason, sizeof debugger->reason, "step");
+    emulate_instruction_debug(chip8, config);
+    chip8->state = PAUSED;
+}
+
+void debugger_report(const debugger_t *debugger, const chip8_t *chip8) {
+    printf("==== PAUSED ==== %s, instruction at 0x%03X\n", debugger->reason, debugger->inst_pc);
+    printf("PC: 0x%03X I: 0x%03X SP: %u DT: %u ST: %u\n",
+           chip8->PC, chip8->I, chip8->SP, chip8->delay_timer, chip8->sound_timer);
+    for (int i = 0; i < 16; i++)
+        printf("V%X: 0x%02X%s", i, chip8->V[i], i % 8 == 7 ? "\n" : " ");
+}
@@ -0,0 +1,95 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+// Debugger: PC breakpoints, RAM read/write watchpoints and register conditions. Breakpoints
+//   and watchpoints are bitmaps over the 4KB address space. They are only checked by the
+//   instrumented core (emulate_instruction_debug), which emulate_frame swaps in for the
+//   whole frame when anything is set, so the normal core pays nothing for them.
+//   Hitting one puts the machine in the PAUSED state.
+
+#include "chip8.h"
+
+#define DEBUGGER_CONDITIONS 8   // Register conditions that can be set at once
+
+// Register a condition looks at
+typedef enum {
+    COND_V0,                    // V0-VF are COND_V0 + X
+    COND_I = COND_V0 + 16,
+    COND_SP,
+    COND_DT,                    // Delay timer
+    COND_ST,                    // Sound timer
+} condition_reg_t;
+
+typedef enum {
+    COND_EQ,
+    COND_NE,
+    COND_LT,
+    COND_LE,
+    COND_GT,
+    COND_GE,
+} condition_op_t;
+
+// Breaks when the condition goes from false to true, not on every instruction it holds
+typedef struct {
+    condition_reg_t reg;
+    condition_op_t op;
+    uint16_t value;
+    bool was_true;
+    const char *text;       // As given on the command line, for reporting
+} debug_condition_t;
+
+struct debugger {
+    uint8_t breakpoints[4096 / 8];  // Bit per address, break before executing there
+    uint8_t read_watch[4096 / 8];   // Bit per address, break after an instruction reads it
+    uint8_t write_watch[4096 / 8];  // Bit per address, break after an instruction writes it
+    debug_condition_t conditions[DEBUGGER_CONDITIONS];
+    uint8_t condition_count;
+    uint32_t active;        // Breakpoints + watchpoints + conditions set, 0 runs the normal core
+    uint16_t inst_pc;       // Address of the instruction being executed
+    uint16_t resume_pc;     // Breakpoint just hit, skipped once when execution resumes there
+    bool hit;               // A watchpoint or condition hit during this instruction
+    char reason[64];        // Why the machine was last paused
+};
+
+static inline bool debugger_bit(const uint8_t *bitmap, const uint16_t addr) {
+    return bitmap[(addr & 0xFFF) >> 3] & (1 << (addr & 7));
+}
+
+// Called by the instrumented core for every RAM read/write an instruction makes
+static inline void debugger_read(debugger_t *debugger, const uint16_t addr) {
+    if (!debugger->hit && debugger_bit(debugger->read_watch, addr)) {
+        debugger->hit = true;
+        snprintf(debugger->reason, sizeof debugger->reason, "read of 0x%03X", addr & 0xFFF);
+    }
+}
+
+static inline void debugger_write(debugger_t *debugger, const uint16_t addr) {
+    if (!debugger->hit && debugger_bit(debugger->write_watch, addr)) {
+        debugger->hit = true;
+        snprintf(debugger->reason, sizeof debugger->reason, "write to 0x%03X", addr & 0xFFF);
+    }
+}
+
+// Set up breakpoints from --break-pc/--break-read/--break-write/--break-if arguments
+bool debugger_from_args(debugger_t *debugger, const int argc, char **argv);
+
+// Breakpoint/watchpoint setters, addresses are 0x000-0xFFF
+void debugger_set_breakpoint(debugger_t *debugger, const uint16_t addr);
+void debugger_set_watch(debugger_t *debugger, const uint16_t addr, const bool read, const bool write);
+
+// Add a register condition like "V3==5" or "I>=0x300", returns false if it can't be parsed
+bool debugger_add_condition(debugger_t *debugger, const char *text);
+
+// Before an instruction: returns false, pausing the machine, if there's a breakpoint at PC
+bool debugger_before(debugger_t *debugger, chip8_t *chip8);
+
+// After an instruction: returns false, pausing the machine, if a watchpoint or condition hit
+bool debugger_after(debugger_t *debugger, chip8_t *chip8);
+
+// Execute 1 instruction of a paused machine, stopping again after it
+void debugger_step(debugger_t *debugger, chip8_t *chip8, const config_t config);
+
+// Print why the machine paused and its registers
+void debugger_report(const debugger_t *debugger, const chip8_t *chip8);
+
+#endif // DEBUGGER_H
@@ -0,0 +1,28 @@
+#include "analysis.h"
+#include "romlib.h"
+
+// Disassemble a ROM from its control flow graph: code is split into basic blocks, sprite
+//   and register load/store data is shown as bytes
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rom_name> [--quirks chip8|superchip|xochip] [--dot]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    config_t config = {0};
+    const frontend_option_t disasm_options[] = {{"--dot", false}, {NULL, false}};
+    if (!set_config_from_args(&config, argc, argv, disasm_options)) exit(EXIT_FAILURE);
+
+    bool dot = false;
+    for (int i = 2; i < argc; i++) 
+        if (strcmp(argv[i], "--dot") == 0) dot = true;
+
+    static rom_t rom;
+    if (!load_rom(&rom, argv[1])) exit(EXIT_FAILURE);
+
+    const analysis_t *analysis = analysis_get(&rom, config.current_extension);
+    if (dot) analysis_print_dot(analysis, &rom, stdout);
+    else analysis_print(analysis, &rom, stdout);
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "romlib.h"
+
+// Fuzz harness for the emulator core, for libFuzzer or AFL++. An input is
+//   byte 0:     quirks profile, 0 CHIP8, 1 SUPERCHIP, 2 XOCHIP (mod 3)
+//   byte 1:     frames to run, 1-64 (mod 64, + 1)
+//   2 per frame: keypad held that frame, bit N for key N
+//   the rest:   ROM bytes, loaded at 0x200
+// Machines reset by copying a booted snapshot and the ROM bytes over it, no file I/O or
+//   init_chip8 per input, so a core runs hundreds of thousands of inputs a second.
+//
+// Built with CHIP8_FUZZ_MAIN there's a main() for running inputs from files, for AFL++
+//   with @@, reproducing crashes and timing: fuzz [--raw] [--runs N] <input>...
+
+#define FUZZ_HEADER_SIZE 2
+#define FUZZ_MAX_FRAMES 64
+#define FUZZ_GUARD_SIZE (64 * 1024 + 64)    // Anything I + 15 or the stack pointer could reach unmasked
+
+// The machine, with guard bytes after it to catch writes past the end of RAM or the stack
+//   in builds without AddressSanitizer, should the core's masking ever break
+static struct {
+    chip8_t chip8;
+    uint8_t guard[FUZZ_GUARD_SIZE];
+} machine;
+
+static chip8_t snapshot;    // Booted machine with no ROM
+static config_t config;
+
+static void fuzz_init(void) {
+    char *no_args[] = {"fuzz"};
+    set_config_from_args(&config, 1, no_args, NULL);
+    config.quirk_db = false;
+    config.rom_index = NULL;
+    config.rng_seed = 1;    // Same input, same run
+    for (int profile = CHIP8; profile <= XOCHIP; profile++) 
+        config.oob_policy[profile] = OOB_WRAP;  // Out of range accesses are safe, not findings
+
+    static rom_t empty;
+    load_rom_bytes(&empty, "fuzz", NULL, 0);
+    init_chip8(&snapshot, config, &empty);
+}
+
+// Run one input. Short inputs are fine, frames without keypad bytes run with no keys held
+//   and a missing ROM is all zeroes.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static bool initialized = false;
+    if (!initialized) {
+        fuzz_init();
+        initialized = true;
+    }
+
+    config_t run_config = config;
+    run_config.current_extension = size > 0 ? (extension_t)(data[0] % 3) : CHIP8;
+    const uint32_t frames = size > 1 ? data[1] % FUZZ_MAX_FRAMES + 1 : 1;
+
+    const uint8_t *keys = data + FUZZ_HEADER_SIZE;
+    const size_t key_bytes = size > FUZZ_HEADER_SIZE ? size - FUZZ_HEADER_SIZE : 0;
+    const size_t rom_offset = FUZZ_HEADER_SIZE + frames * 2;
+    size_t rom_size = size > rom_offset ? size - rom_offset : 0;
+    if (rom_size > CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT)
+        rom_size = CHIP8_RAM_SIZE - CHIP8_ENTRY_POINT;
+
+    chip8_t *chip8 = &machine.chip8;
+    memcpy(chip8, &snapshot, sizeof *chip8);
+    if (rom_size) memcpy(&chip8->ram[CHIP8_ENTRY_POINT], data + rom_offset, rom_size);
+
+    for (uint32_t frame = 0; frame < frames && chip8->state != QUIT; frame++) {
+        const uint16_t held = frame * 2 + 1 < key_bytes ?
+                              (keys[frame * 2] << 8) | keys[frame * 2 + 1] : 0;
+        for (int key = 0; key < 16; key++) chip8->keypad[key] = (held >> key) & 1;
+
+        emulate_frame(chip8, run_config, NULL);
+    }
+
+    // RAM's own guard bytes have to stay a copy of its start, or wrapped sprites read junk
+    if (memcmp(&chip8->ram[CHIP8_RAM_SIZE], &chip8->ram[0], CHIP8_RAM_GUARD) != 0) abort();
+
+    return 0;
+}
+
+#ifdef CHIP8_FUZZ_MAIN
+// Guard bytes are all still 0
+static bool guard_intact(void) {
+    for (size_t i = 0; i < sizeof machine.guard; i++)
+        if (machine.guard[i]) return false;
+    return true;
+}
+
+// Read a whole file, NULL if it can't be read
+static uint8_t *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = malloc(length > 0 ? length : 1);
+    if (data) *size = fread(data, 1, length > 0 ? length : 0, file);
+    fclose(file);
+    return data;
+}
+
+// Run inputs from files, each --runs times, and report how many a second went through.
+//   With --raw the files are plain ROMs, run as CHIP8 for 64 frames with no keys.
+int main(int argc, char **argv) {
+    bool raw = false;
+    uint64_t runs = 1;
+    int first = 1;
+
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+        if (strcmp(argv[first], "--raw") == 0) raw = true;
+        else if (strcmp(argv[first], "--runs") == 0 && first + 1 < argc)
+            runs = strtoull(argv[++first], NULL, 10);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[first]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s [--raw] [--runs N] <input>...\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    bool ok = true;
+    uint64_t execs = 0;
+    const uint64_t start_time = monotonic_ns();
+
+    for (int i = first; i < argc; i++) {
+        size_t size = 0;
+        uint8_t *file = read_file(argv[i], &size);
+        if (!file) {
+            ok = false;
+            continue;
+        }
+
+        // Plain ROMs get a header and an empty keypad in front of them
+        uint8_t *data = file;
+        if (raw) {
+            const size_t header = FUZZ_HEADER_SIZE + FUZZ_MAX_FRAMES * 2;
+            data = calloc(header + size, 1);
+            if (!data) exit(EXIT_FAILURE);
+            data[1] = FUZZ_MAX_FRAMES - 1;
+            memcpy(data + header, file, size);
+            size += header;
+        }
+
+        for (uint64_t run = 0; run < runs; run++) {
+            LLVMFuzzerTestOneInput(data, size);
+            execs++;
+        }
+
+        if (!guard_intact()) {
+            fprintf(stderr, "%s: wrote past the end of the machine\n", argv[i]);
+            abort();    // A crash, for AFL++
+        }
+
+        if (data != file) free(data);
+        free(file);
+    }
+
+    const double elapsed = (double)(monotonic_ns() - start_time) / 1e9;
+    printf("%llu execs in %.3fs (%.0f execs/s)\n", (long long unsigned)execs, elapsed,
+           elapsed > 0 ? execs / elapsed : 0.0);
+
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+#endif
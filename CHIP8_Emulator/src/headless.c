@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+#include "audio.h"
+#include "romlib.h"
+#include "quirkdb.h"
+#include "movie.h"
+#include "perfcount.h"
+#ifdef PROFILE
+#include "profile.h"
+#endif
+#ifdef TRACE
+#include "trace.h"
+#endif
+
+// Headless runner options, on top of the emulator configuration
+typedef struct {
+    uint64_t frames;                // Number of 60hz frames to emulate
+    const char *wav_file;           // Write rendered audio here, if set
+    const char *sound_bits_file;    // Write per-frame sound on/off bitmap here, if set
+    const char *replay_file;        // Replay keypad input from this movie, if set
+    const char *record_file;        // Record keypad input to this movie, if set
+    bool random_keys;               // Press pseudo random keys, from random_keys_seed
+    uint64_t random_keys_seed;
+    const char **rom_names;         // ROMs to run, in order
+    int rom_count;
+} headless_opts_t;
+
+// Get headless runner options from passed in arguments, anything that isn't an option 
+//   or an option's value is a ROM to run
+bool set_headless_opts_from_args(headless_opts_t *opts, const config_t config, const int argc, 
+                                 char **argv) {
+    *opts = (headless_opts_t){
+        .frames = config.frames ? config.frames : 600,  // 10 seconds of emulated time
+        .wav_file = config.wav_file,
+        .sound_bits_file = config.sound_bits_file,
+        .record_file = config.record_movie,
+        .rom_names = calloc(argc, sizeof(char *)),
+    };
+    if (!opts->rom_names) return false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            opts->rom_names[opts->rom_count++] = argv[i];
+            continue;
+        }
+        if (is_config_flag(argv[i])) continue;
+        if (i + 1 >= argc) break;   // Missing value
+
+        if (strcmp(argv[i], "--replay") == 0) 
+            opts->replay_file = argv[++i];
+        else if (strcmp(argv[i], "--random-keys") == 0) {
+            opts->random_keys = true;
+            opts->random_keys_seed = strtoull(argv[++i], NULL, 10);
+        }
+        else
+            i++;    // Emulator option, skip its value
+    }
+
+    if (opts->rom_count == 0) {
+        fprintf(stderr, "No ROMs to run\n");
+        return false;
+    }
+    if (opts->rom_count > 1 && (opts->wav_file || opts->sound_bits_file)) {
+        fprintf(stderr, "Audio capture only works with a single ROM\n");
+        return false;
+    }
+    if (opts->rom_count > 1 && (opts->replay_file || opts->record_file)) {
+        fprintf(stderr, "Movies only work with a single ROM\n");
+        return false;
+    }
+    if (opts->replay_file && (opts->record_file || opts->random_keys)) {
+        fprintf(stderr, "A replay plays the movie's input, it can't record or press random keys\n");
+        return false;
+    }
+
+    return true;    // Success
+}
+
+// Keypad for a frame with --random-keys: a new random key, or none, every 8 frames
+static void press_random_keys(chip8_t *chip8, const uint64_t seed, const uint64_t frame) {
+    uint64_t x = (seed ^ (frame / 8)) * 0x9E3779B97F4A7C15ull;
+    x ^= x >> 29;
+    const uint8_t pick = (x >> 32) % 17;
+    for (int key = 0; key < 16; key++) chip8->keypad[key] = key == pick;
+}
+
+// Run a ROM for opts->frames frames, or the length of the movie when replaying one, 
+//   rendering audio offline. Input is recorded to opts->record_file if set.
+bool run_rom(const rom_t *rom, const config_t config, const headless_opts_t *opts, movie_t *movie) {
+    chip8_t chip8 = {0};
+    if (!init_chip8(&chip8, config, rom)) return false;
+
+    // Offline audio runs in lockstep with emulated time
+    audio_t *audio = malloc(sizeof *audio);     // Too big for a worker thread's stack
+    if (!audio) return false;
+    audio_init(audio, &config, true);
+    audio_capture_t capture = {.keep_pcm = opts->wav_file != NULL};
+
+    const uint64_t frames = movie ? movie->frames : opts->frames;
+
+    static movie_t record;  // Only ever one ROM when recording
+    if (opts->record_file) movie_start(&record, rom, config);
+
+    // Hardware counters around each frame, if asked for and the host has them
+    perfcount_t perf;
+    const bool counting = config.perf_counters && perfcount_open(&perf);
+
+    const uint64_t start_time = monotonic_ns();
+    uint64_t insts = 0;
+    uint64_t sound_frames = 0;
+
+    for (uint64_t frame = 0; frame < frames && chip8.state == RUNNING; frame++) {
+        if (movie) movie_play_frame(movie, &chip8);
+        if (opts->random_keys) press_random_keys(&chip8, opts->random_keys_seed, frame);
+        if (opts->record_file && !movie_record_frame(&record, &chip8)) {
+            fprintf(stderr, "Out of memory recording the movie\n");
+            movie_free(&record);
+            free(audio);
+            return false;
+        }
+        if (counting) perfcount_begin_frame(&perf, config);
+        const uint32_t frame_insts = emulate_frame(&chip8, config, audio);
+        if (counting) perfcount_end_frame(&perf, config, frame_insts);
+        insts += frame_insts;
+        sound_frames += audio->frame_sound_on;
+
+        if (!audio_capture_frame(audio, &capture)) {
+            fprintf(stderr, "Out of memory capturing audio\n");
+            audio_capture_free(&capture);
+            free(audio);
+            return false;
+        }
+    }
+    free(audio);
+
+    const double elapsed = (double)(monotonic_ns() - start_time) / 1e9;
+
+    printf("%s: %llu frames, %llu instructions in %.3fs (%.1f MIPS), sound on for %llu frames\n",
+           rom->name, (long long unsigned)capture.frames, (long long unsigned)insts, elapsed,
+           elapsed > 0 ? insts / elapsed / 1e6 : 0.0, (long long unsigned)sound_frames);
+
+    if (counting) {
+        perfcount_report(&perf, stdout);
+        perfcount_close(&perf);
+    }
+
+    bool ok = true;
+    if (opts->record_file) {
+        movie_finish(&record, &chip8);
+        ok = movie_save(&record, opts->record_file);
+        if (ok) printf("Recorded %u frames to %s, state hash %08x\n", record.frames, 
+                       opts->record_file, record.end_hash);
+        else fprintf(stderr, "Could not write movie %s\n", opts->record_file);
+        movie_free(&record);
+    }
+    if (movie) {
+        const uint32_t hash = movie_state_hash(&chip8);
+        if (hash == movie->end_hash) {
+            printf("Replay matches the recording, state hash %08x\n", hash);
+        } else {
+            printf("Replay desynced: state hash %08x, recorded %08x\n", hash, movie->end_hash);
+            ok = false;
+#ifdef TRACE
+            if (trace_dump(config.trace, config.trace_file, TRACE_SIZE)) 
+                printf("Instruction trace written to %s\n", config.trace_file);
+#endif
+        }
+    }
+
+    if (opts->wav_file) 
+        ok &= audio_write_wav(&capture, opts->wav_file, config.audio_sample_rate);
+    if (opts->sound_bits_file) 
+        ok &= audio_write_sound_bits(&capture, opts->sound_bits_file);
+
+    audio_capture_free(&capture);
+    return ok;
+}
+
+// ROMs for the worker threads to run, each takes the next one not yet started
+typedef struct {
+    const rom_t **roms;             // NULL for ROMs that didn't load
+    config_t *configs;
+    const headless_opts_t *opts;
+    atomic_int next;
+    atomic_bool ok;
+} rom_queue_t;
+
+static void *run_roms_worker(void *arg) {
+    rom_queue_t *queue = arg;
+    for (int i; (i = atomic_fetch_add(&queue->next, 1)) < queue->opts->rom_count; ) {
+        if (queue->roms[i] && !run_rom(queue->roms[i], queue->configs[i], queue->opts, NULL)) 
+            atomic_store(&queue->ok, false);
+    }
+    return NULL;
+}
+
+// Run ROMs for a fixed number of frames at full speed, without a window or audio device.
+//   Audio is rendered offline against emulated time.
+int main(int argc, char **argv) {
+    // Default Usage message for args
+    if (argc < 2) {
+       fprintf(stderr, "Usage: %s <rom_name>... [--frames N] [--wav out.wav] "
+                       "[--sound-bitmap out.bin] [--replay movie.c8m] [--record movie.c8m] [--random-keys SEED] [--threads N] [--help]\n", argv[0]);
+       exit(EXIT_FAILURE);
+    }
+
+    // Options from a config file go in front of the command line ones
+    if (!expand_config_file(&argc, &argv)) exit(EXIT_FAILURE);
+
+    // Initialize emulator configuration/options
+    config_t config = {0};
+    const frontend_option_t headless_options[] = {
+        {"--replay", true}, {"--random-keys", true}, {NULL, false},
+    };
+    if (!set_config_from_args(&config, argc, argv, headless_options)) exit(EXIT_FAILURE);
+
+    headless_opts_t opts = {0};
+    if (!set_headless_opts_from_args(&opts, config, argc, argv)) exit(EXIT_FAILURE);
+
+    // ROMs come from the library, so repeated batch runs only re-read changed files
+    static rom_library_t roms;
+    if (!romlib_open(&roms, config.rom_index)) exit(EXIT_FAILURE);
+
+    static movie_t movie;
+    if (opts.replay_file && !movie_load(&movie, opts.replay_file)) exit(EXIT_FAILURE);
+
+    // Profiles and traces are one per process, and a replay is a single ROM
+    uint32_t threads = config.threads;
+#if defined(PROFILE) || defined(TRACE)
+    threads = 1;
+#endif
+    if (opts.replay_file || opts.record_file || threads > (uint32_t)opts.rom_count) threads = 1;
+
+    bool ok = true;
+    if (threads > 1) {
+        // Loading and quirk lookups stay on this thread, only the emulation runs in parallel
+        rom_queue_t queue = {
+            .roms = calloc(opts.rom_count, sizeof(rom_t *)),
+            .configs = calloc(opts.rom_count, sizeof(config_t)),
+            .opts = &opts,
+        };
+        pthread_t *workers = calloc(threads, sizeof(pthread_t));
+        if (!queue.roms || !queue.configs || !workers) exit(EXIT_FAILURE);
+        atomic_init(&queue.next, 0);
+        atomic_init(&queue.ok, true);
+
+        for (int i = 0; i < opts.rom_count; i++) {
+            queue.roms[i] = romlib_load(&roms, opts.rom_names[i]);
+            if (!queue.roms[i]) {
+                ok = false;
+                continue;
+            }
+            queue.configs[i] = config;
+            quirkdb_apply(&queue.configs[i], queue.roms[i]);
+        }
+
+        uint32_t started = 0;
+        for (; started < threads; started++) 
+            if (pthread_create(&workers[started], NULL, run_roms_worker, &queue) != 0) break;
+        if (started == 0) run_roms_worker(&queue);  // Run them here if no thread would start
+        for (uint32_t i = 0; i < started; i++) pthread_join(workers[i], NULL);
+
+        ok &= atomic_load(&queue.ok);
+        free(workers);
+        free(queue.configs);
+        free(queue.roms);
+    }
+
+    for (int i = 0; threads == 1 && i < opts.rom_count; i++) {
+        const rom_t *rom = romlib_load(&roms, opts.rom_names[i]);
+        if (!rom) {
+            ok = false;
+            continue;
+        }
+
+        // Each ROM runs with its own profile from the quirk database, if it has one
+        config_t rom_config = config;
+        quirkdb_apply(&rom_config, rom);
+
+        // Movies replay with the config they were recorded with, on the same ROM
+        if (opts.replay_file) {
+            if (memcmp(movie.rom_sha1, rom->sha1, SHA1_SIZE) != 0) {
+                fprintf(stderr, "%s was not recorded with %s\n", opts.replay_file, rom->name);
+                ok = false;
+                continue;
+            }
+            movie_apply_config(&movie, &rom_config);
+        }
+
+#ifdef TRACE
+        static trace_t trace;
+        atomic_store(&trace.head, 0);
+        rom_config.trace = &trace;
+#endif
+
+#ifdef PROFILE
+        // Profile each ROM on its own
+        static profile_t profile;
+        memset(&profile, 0, sizeof profile);
+        rom_config.profile = &profile;
+#endif
+
+        ok &= run_rom(rom, rom_config, &opts, opts.replay_file ? &movie : NULL);
+
+#ifdef PROFILE
+        ok &= profile_dump(&profile, rom->name);
+#endif
+    }
+
+    movie_free(&movie);
+    romlib_close(&roms);
+    free(opts.rom_names);
+
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
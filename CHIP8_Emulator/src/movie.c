@@ -0,0 +1,188 @@
+#include "movie.h"
+
+// Movie file format, all fields little endian with no padding:
+//
+//   offset  size  field
+//   0       4     magic "C8MV"
+//   4       2     format version (MOVIE_VERSION)
+//   6       2     flags, reserved (0)
+//   8       20    ROM SHA-1
+//   28      8     RNG seed
+//   36      4     instructions per second
+//   40      1     extension/quirks
+//   41      3     reserved (0)
+//   44      4     number of frames
+//   48      4     end state hash
+//   52      4     number of runs
+//   56      ...   runs: keypad bits (2), frames (4)
+
+#define MOVIE_MAGIC "C8MV"
+
+// Hash of the full machine state, to check a replay ended where the recording did
+uint32_t movie_state_hash(const chip8_t *chip8) {
+    uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    const size_t size = serialize_state(chip8, buf, sizeof buf);
+    return fnv1a_hash(buf, size);
+}
+
+static uint16_t keypad_bits(const chip8_t *chip8) {
+    uint16_t bits = 0;
+    for (int i = 0; i < 16; i++) 
+        bits |= chip8->keypad[i] << i;
+    return bits;
+}
+
+// Start recording from boot, the machine must have just been initialized with rom and config
+void movie_start(movie_t *movie, const rom_t *rom, const config_t config) {
+    movie_free(movie);
+    *movie = (movie_t){
+        .seed = config.rng_seed,
+        .insts_per_second = config.insts_per_second,
+        .extension = config.current_extension,
+        .recording = true,
+    };
+    memcpy(movie->rom_sha1, rom->sha1, SHA1_SIZE);
+}
+
+// Record the keypad for the frame about to be emulated
+bool movie_record_frame(movie_t *movie, const chip8_t *chip8) {
+    if (!movie->recording) return true;
+
+    const uint16_t keypad = keypad_bits(chip8);
+    movie->frames++;
+
+    // Same keys as last frame, extend the run
+    if (movie->run_count > 0 && movie->runs[movie->run_count - 1].keypad == keypad) {
+        movie->runs[movie->run_count - 1].frames++;
+        return true;
+    }
+
+    if (movie->run_count == movie->run_capacity) {
+        const uint32_t capacity = movie->run_capacity ? movie->run_capacity * 2 : 256;
+        movie_run_t *runs = realloc(movie->runs, capacity * sizeof *runs);
+        if (!runs) {
+            movie->frames--;
+            movie->recording = false;
+            return false;
+        }
+        movie->runs = runs;
+        movie->run_capacity = capacity;
+    }
+
+    movie->runs[movie->run_count++] = (movie_run_t){.keypad = keypad, .frames = 1};
+    return true;
+}
+
+// Stop recording, chip8 is the state after the last recorded frame
+void movie_finish(movie_t *movie, const chip8_t *chip8) {
+    movie->end_hash = movie_state_hash(chip8);
+    movie->recording = false;
+}
+
+bool movie_save(const movie_t *movie, const char *filename) {
+    const size_t size = MOVIE_HEADER_SIZE + (size_t)movie->run_count * MOVIE_RUN_SIZE;
+    uint8_t *buf = calloc(1, size);
+    if (!buf) return false;
+
+    memcpy(&buf[0], MOVIE_MAGIC, 4);
+    put_u16(&buf[4], MOVIE_VERSION);
+    memcpy(&buf[8], movie->rom_sha1, SHA1_SIZE);
+    put_u64(&buf[28], movie->seed);
+    put_u32(&buf[36], movie->insts_per_second);
+    buf[40] = movie->extension;
+    put_u32(&buf[44], movie->frames);
+    put_u32(&buf[48], movie->end_hash);
+    put_u32(&buf[52], movie->run_count);
+
+    uint8_t *run = &buf[MOVIE_HEADER_SIZE];
+    for (uint32_t i = 0; i < movie->run_count; i++, run += MOVIE_RUN_SIZE) {
+        put_u16(&run[0], movie->runs[i].keypad);
+        put_u32(&run[2], movie->runs[i].frames);
+    }
+
+    const bool ok = write_file_atomic(filename, buf, size);
+    free(buf);
+    return ok;
+}
+
+bool movie_load(movie_t *movie, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open movie file %s\n", filename);
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    if (fread(header, 1, sizeof header, file) != sizeof header || 
+        memcmp(header, MOVIE_MAGIC, 4) != 0 || get_u16(&header[4]) != MOVIE_VERSION) {
+        fprintf(stderr, "%s is not a version %d movie file\n", filename, MOVIE_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    movie_free(movie);
+    *movie = (movie_t){
+        .seed = get_u64(&header[28]),
+        .insts_per_second = get_u32(&header[36]),
+        .extension = header[40],
+        .frames = get_u32(&header[44]),
+        .end_hash = get_u32(&header[48]),
+        .run_count = get_u32(&header[52]),
+    };
+    memcpy(movie->rom_sha1, &header[8], SHA1_SIZE);
+
+    // Runs have to add up to the frame count
+    bool ok = movie->extension <= XOCHIP && movie->run_count <= movie->frames;
+    if (ok && movie->run_count > 0) {
+        movie->runs = malloc(movie->run_count * sizeof *movie->runs);
+        movie->run_capacity = movie->run_count;
+        ok = movie->runs != NULL;
+    }
+
+    uint64_t frames = 0;
+    for (uint32_t i = 0; ok && i < movie->run_count; i++) {
+        uint8_t run[MOVIE_RUN_SIZE];
+        ok = fread(run, 1, sizeof run, file) == sizeof run;
+        movie->runs[i] = (movie_run_t){.keypad = get_u16(&run[0]), .frames = get_u32(&run[2])};
+        frames += movie->runs[i].frames;
+    }
+    fclose(file);
+
+    if (!ok || frames != movie->frames) {
+        fprintf(stderr, "Movie file %s is corrupt\n", filename);
+        movie_free(movie);
+        return false;
+    }
+
+    return true;
+}
+
+// Use the config the movie was recorded with
+void movie_apply_config(const movie_t *movie, config_t *config) {
+    config->insts_per_second = movie->insts_per_second;
+    config->current_extension = movie->extension;
+    config->rng_seed = movie->seed;
+}
+
+// Set the keypad for the next frame, false once the movie is over
+bool movie_play_frame(movie_t *movie, chip8_t *chip8) {
+    while (movie->play_run < movie->run_count && 
+           movie->play_frame == movie->runs[movie->play_run].frames) {
+        movie->play_run++;
+        movie->play_frame = 0;
+    }
+    if (movie->play_run == movie->run_count) return false;
+
+    const uint16_t keypad = movie->runs[movie->play_run].keypad;
+    for (int i = 0; i < 16; i++) 
+        chip8->keypad[i] = (keypad >> i) & 1;
+
+    movie->play_frame++;
+    return true;
+}
+
+void movie_free(movie_t *movie) {
+    free(movie->runs);
+    movie->runs = NULL;
+    movie->run_count = movie->run_capacity = 0;
+}
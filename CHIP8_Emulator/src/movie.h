@@ -0,0 +1,53 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+// Input movies: the keypad state of every emulated frame, run length encoded, with the RNG 
+//   seed and the config that affects emulation. Replaying a movie from boot reproduces the 
+//   recorded run exactly, which is checked against a hash of the final machine state.
+
+#include "chip8.h"
+#include "sha1.h"
+
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 56
+#define MOVIE_RUN_SIZE 6
+
+// Keypad state held for a number of frames
+typedef struct {
+    uint16_t keypad;        // Bit N = key N pressed
+    uint32_t frames;
+} movie_run_t;
+
+typedef struct {
+    uint8_t rom_sha1[SHA1_SIZE];    // ROM the movie was recorded with
+    uint64_t seed;                  // RNG seed at boot (config rng_seed)
+    uint32_t insts_per_second;
+    extension_t extension;
+    uint32_t frames;                // Frames recorded
+    uint32_t end_hash;              // FNV-1a of the serialized state after the last frame
+
+    movie_run_t *runs;
+    uint32_t run_count;
+    uint32_t run_capacity;
+    bool recording;
+
+    uint32_t play_run;              // Replay position: current run and frame within it
+    uint32_t play_frame;
+} movie_t;
+
+uint32_t movie_state_hash(const chip8_t *chip8);
+
+// Recording
+void movie_start(movie_t *movie, const rom_t *rom, const config_t config);
+bool movie_record_frame(movie_t *movie, const chip8_t *chip8);
+void movie_finish(movie_t *movie, const chip8_t *chip8);
+bool movie_save(const movie_t *movie, const char *filename);
+
+// Replay
+bool movie_load(movie_t *movie, const char *filename);
+void movie_apply_config(const movie_t *movie, config_t *config);
+bool movie_play_frame(movie_t *movie, chip8_t *chip8);
+
+void movie_free(movie_t *movie);
+
+#endif // MOVIE_H
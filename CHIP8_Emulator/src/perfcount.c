@@ -0,0 +1,168 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perfcount.h"
+
+static const char *counter_names[] = {"cycles", "instructions", "branch-misses", "cache-misses"};
+
+#ifdef __linux__
+static const uint64_t counter_configs[] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+};
+
+bool perfcount_open(perfcount_t *perf) {
+    memset(perf, 0, sizeof *perf);
+
+    // First counter that opens leads the group, the others are added to it
+    int leader = -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr = {
+            .type = PERF_TYPE_HARDWARE,
+            .size = sizeof attr,
+            .config = counter_configs[i],
+            .disabled = leader == -1,
+            .exclude_kernel = 1,    // Not the read() syscalls, and works with perf_event_paranoid 2
+            .exclude_hv = 1,
+            .read_format = PERF_FORMAT_GROUP,
+        };
+        perf->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        perf->slots[i] = perf->fds[i] == -1 ? -1 : perf->opened++;
+        if (leader == -1) leader = perf->fds[i];
+    }
+
+    if (leader == -1 || perf->fds[PERF_CYCLES] == -1) {
+        fprintf(stderr, "No hardware counters from perf_event_open, check "
+                        "/proc/sys/kernel/perf_event_paranoid\n");
+        perfcount_close(perf);
+        return false;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void perfcount_close(perfcount_t *perf) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf->fds[i] >= 0) close(perf->fds[i]);
+        perf->fds[i] = -1;
+    }
+    perf->opened = 0;
+}
+
+// Read the whole group at once, values of counters that aren't open are left alone
+static void read_counters(const perfcount_t *perf, uint64_t *values) {
+    uint64_t buf[1 + PERF_COUNTER_COUNT];
+    int leader = -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT && leader == -1; i++) leader = perf->fds[i];
+    if (leader == -1 || read(leader, buf, sizeof buf) < (ssize_t)(sizeof(uint64_t) * (1 + perf->opened)))
+        return;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        if (perf->slots[i] != -1) values[i] = buf[1 + perf->slots[i]];
+}
+#else
+bool perfcount_open(perfcount_t *perf) {
+    memset(perf, 0, sizeof *perf);
+    fprintf(stderr, "Hardware counters need Linux perf_event_open\n");
+    return false;
+}
+
+void perfcount_close(perfcount_t *perf) {
+    perf->opened = 0;
+}
+
+static void read_counters(const perfcount_t *perf, uint64_t *values) {
+    (void)perf;
+    (void)values;
+}
+#endif
+
+void perfcount_begin_frame(perfcount_t *perf, const config_t config) {
+    (void)config;
+    if (!perf->opened) return;
+
+#ifdef PROFILE
+    if (config.profile)
+        memcpy(perf->class_start, config.profile->class_counts, sizeof perf->class_start);
+#endif
+    read_counters(perf, perf->start);
+}
+
+void perfcount_end_frame(perfcount_t *perf, const config_t config, const uint32_t insts) {
+    (void)config;
+    if (!perf->opened) return;
+
+    uint64_t end[PERF_COUNTER_COUNT] = {0};
+    read_counters(perf, end);
+
+    uint64_t delta[PERF_COUNTER_COUNT];
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        delta[i] = end[i] - perf->start[i];
+        perf->totals[i] += delta[i];
+    }
+    if (delta[PERF_CYCLES] > perf->max_frame_cycles) perf->max_frame_cycles = delta[PERF_CYCLES];
+    perf->frames++;
+    perf->insts += insts;
+
+#ifdef PROFILE
+    // Put the frame down to the opcode class it ran the most of
+    if (config.profile && insts) {
+        int top = 0;
+        uint64_t top_count = 0;
+        for (int c = 0; c < OP_CLASS_COUNT; c++) {
+            const uint64_t count = config.profile->class_counts[c] - perf->class_start[c];
+            if (count > top_count) {
+                top = c;
+                top_count = count;
+            }
+        }
+        perf->class_frames[top]++;
+        perf->class_insts[top] += insts;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) perf->class_totals[top][i] += delta[i];
+    }
+#endif
+}
+
+void perfcount_report(const perfcount_t *perf, FILE *out) {
+    if (!perf->opened || !perf->frames) return;
+
+    const double frames = (double)perf->frames;
+    const double kinsts = perf->insts / 1000.0;
+
+    fprintf(out, "Hardware counters, %llu frames, %llu CHIP8 instructions:\n",
+            (long long unsigned)perf->frames, (long long unsigned)perf->insts);
+    fprintf(out, "  %-14s %14s %14s\n", "counter", "per frame", "per 1000 insts");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf->slots[i] == -1) {
+            fprintf(out, "  %-14s %14s %14s\n", counter_names[i], "n/a", "n/a");
+            continue;
+        }
+        fprintf(out, "  %-14s %14.0f %14.1f\n", counter_names[i], perf->totals[i] / frames,
+                kinsts > 0 ? perf->totals[i] / kinsts : 0.0);
+    }
+
+    fprintf(out, "  host cycles per CHIP8 instruction: %.2f, max cycles in a frame: %llu\n",
+            perf->insts ? (double)perf->totals[PERF_CYCLES] / perf->insts : 0.0,
+            (long long unsigned)perf->max_frame_cycles);
+    if (perf->slots[PERF_INSTRUCTIONS] != -1 && perf->totals[PERF_CYCLES])
+        fprintf(out, "  host instructions per cycle: %.2f\n",
+                (double)perf->totals[PERF_INSTRUCTIONS] / perf->totals[PERF_CYCLES]);
+
+#ifdef PROFILE
+    fprintf(out, "  by the opcode class a frame ran the most of:\n");
+    fprintf(out, "  %-8s %10s %14s %16s\n", "class", "frames", "cycles/inst", "br-miss/1000");
+    for (int c = 0; c < OP_CLASS_COUNT; c++) {
+        if (!perf->class_insts[c]) continue;
+        fprintf(out, "  %-8s %10llu %14.2f %16.2f\n", opcode_class_name(c),
+                (long long unsigned)perf->class_frames[c],
+                (double)perf->class_totals[c][PERF_CYCLES] / perf->class_insts[c],
+                perf->class_totals[c][PERF_BRANCH_MISSES] * 1000.0 / perf->class_insts[c]);
+    }
+#endif
+}
@@ -0,0 +1,51 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+// Host hardware counters per emulated frame, with --perf on Linux. Cycles, instructions,
+//   branch misses and cache misses are opened as one perf_event_open group for this thread
+//   (user space only) and read before and after each emulate_frame, so only the emulator
+//   is counted. Reported per frame, per 1000 CHIP8 instructions and as host cycles per
+//   CHIP8 instruction. Built with -DPROFILE each frame is also put down to the opcode
+//   class it ran the most of, to see which instructions the host time goes to.
+
+#include "chip8.h"
+#ifdef PROFILE
+#include "profile.h"
+#endif
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_CACHE_MISSES,
+    PERF_COUNTER_COUNT,
+} perf_counter_t;
+
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];            // -1 for counters this host doesn't have
+    int slots[PERF_COUNTER_COUNT];          // Position in a group read, -1 if not opened
+    int opened;
+    uint64_t start[PERF_COUNTER_COUNT];     // Values at the start of the current frame
+    uint64_t totals[PERF_COUNTER_COUNT];
+    uint64_t frames;
+    uint64_t insts;                         // CHIP8 instructions
+    uint64_t max_frame_cycles;
+#ifdef PROFILE
+    uint64_t class_start[OP_CLASS_COUNT];
+    uint64_t class_frames[OP_CLASS_COUNT];  // Frames each class was the most run in
+    uint64_t class_insts[OP_CLASS_COUNT];
+    uint64_t class_totals[OP_CLASS_COUNT][PERF_COUNTER_COUNT];
+#endif
+} perfcount_t;
+
+// Open the counters, false if there's no perf_event_open or no hardware counters
+bool perfcount_open(perfcount_t *perf);
+void perfcount_close(perfcount_t *perf);
+
+// Call around emulate_frame, insts is what it returned
+void perfcount_begin_frame(perfcount_t *perf, const config_t config);
+void perfcount_end_frame(perfcount_t *perf, const config_t config, const uint32_t insts);
+
+void perfcount_report(const perfcount_t *perf, FILE *out);
+
+#endif // PERFCOUNT_H
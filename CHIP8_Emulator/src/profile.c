@@ -0,0 +1,203 @@
+#include "profile.h"
+
+static const char *class_names[OP_CLASS_COUNT] = {
+    "00E0", "00EE", "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+    "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+    "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+    "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+    "????",
+};
+
+opcode_class_t opcode_class(const uint16_t opcode) {
+    const uint8_t N = opcode & 0x0F;
+    const uint8_t NN = opcode & 0xFF;
+
+    switch (opcode >> 12) {
+        case 0x0: 
+            if (opcode == 0x00E0) return OP_00E0;
+            if (opcode == 0x00EE) return OP_00EE;
+            return OP_0NNN;
+        case 0x1: return OP_1NNN;
+        case 0x2: return OP_2NNN;
+        case 0x3: return OP_3XNN;
+        case 0x4: return OP_4XNN;
+        case 0x5: return N == 0 ? OP_5XY0 : OP_UNKNOWN;
+        case 0x6: return OP_6XNN;
+        case 0x7: return OP_7XNN;
+        case 0x8:
+            if (N <= 0x7) return OP_8XY0 + N;
+            return N == 0xE ? OP_8XYE : OP_UNKNOWN;
+        case 0x9: return N == 0 ? OP_9XY0 : OP_UNKNOWN;
+        case 0xA: return OP_ANNN;
+        case 0xB: return OP_BNNN;
+        case 0xC: return OP_CXNN;
+        case 0xD: return OP_DXYN;
+        case 0xE: 
+            if (NN == 0x9E) return OP_EX9E;
+            return NN == 0xA1 ? OP_EXA1 : OP_UNKNOWN;
+        case 0xF:
+            switch (NN) {
+                case 0x07: return OP_FX07;
+                case 0x0A: return OP_FX0A;
+                case 0x15: return OP_FX15;
+                case 0x18: return OP_FX18;
+                case 0x1E: return OP_FX1E;
+                case 0x29: return OP_FX29;
+                case 0x33: return OP_FX33;
+                case 0x55: return OP_FX55;
+                case 0x65: return OP_FX65;
+                default: return OP_UNKNOWN;
+            }
+    }
+    return OP_UNKNOWN;
+}
+
+const char *opcode_class_name(const opcode_class_t op_class) {
+    return class_names[op_class];
+}
+
+typedef struct {
+    uint64_t count;
+    uint32_t index;
+} ranked_t;
+
+static int by_count_desc(const void *a, const void *b) {
+    const ranked_t *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->index < y->index ? -1 : 1;
+}
+
+// Sort nonzero counts, biggest first, returns how many there are
+static uint32_t rank(const uint64_t *counts, const uint32_t size, ranked_t *ranked) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < size; i++)
+        if (counts[i]) ranked[n++] = (ranked_t){.count = counts[i], .index = i};
+    qsort(ranked, n, sizeof *ranked, by_count_desc);
+    return n;
+}
+
+// Human readable report: totals, instructions per frame, then the hottest opcodes and addresses
+void profile_report(const profile_t *profile, FILE *out) {
+    static ranked_t ranked[4096];
+    const double insts = profile->insts ? (double)profile->insts : 1.0;
+
+    fprintf(out, "%llu frames, %llu instructions, %.1f MIPS emulated\n",
+            (long long unsigned)profile->frames, (long long unsigned)profile->insts,
+            profile->frame_ns ? profile->insts * 1e3 / profile->frame_ns : 0.0);
+
+    // Instructions per frame, from the histogram
+    int min = -1, max = 0;
+    for (int i = 0; i <= PROFILE_MAX_FRAME_INSTS; i++) 
+        if (profile->frame_insts[i]) {
+            if (min < 0) min = i;
+            max = i;
+        }
+    fprintf(out, "Instructions per frame: min %d, avg %.1f, max %d%s\n", min < 0 ? 0 : min,
+            profile->frames ? (double)profile->insts / profile->frames : 0.0, max,
+            max == PROFILE_MAX_FRAME_INSTS ? "+" : "");
+
+    fprintf(out, "\nOpcode      Count      %%\n");
+    uint32_t n = rank(profile->class_counts, OP_CLASS_COUNT, ranked);
+    for (uint32_t i = 0; i < n; i++) 
+        fprintf(out, "%-6s %12llu %6.2f\n", class_names[ranked[i].index], 
+                (long long unsigned)ranked[i].count, ranked[i].count * 100.0 / insts);
+
+    fprintf(out, "\nAddress  Opcode        Count      %%\n");
+    n = rank(profile->pc_counts, 4096, ranked);
+    for (uint32_t i = 0; i < n && i < 20; i++) 
+        fprintf(out, "0x%03X    %04X   %12llu %6.2f\n", ranked[i].index, 
+                profile->pc_opcode[ranked[i].index], (long long unsigned)ranked[i].count, 
+                ranked[i].count * 100.0 / insts);
+}
+
+bool profile_write_json(const profile_t *profile, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", filename);
+        return false;
+    }
+
+    fprintf(file, "{\n  \"frames\": %llu,\n  \"instructions\": %llu,\n  \"host_ns\": %llu,\n",
+            (long long unsigned)profile->frames, (long long unsigned)profile->insts,
+            (long long unsigned)profile->frame_ns);
+
+    fprintf(file, "  \"opcodes\": {");
+    const char *sep = "";
+    for (int i = 0; i < OP_CLASS_COUNT; i++) {
+        if (!profile->class_counts[i]) continue;
+        fprintf(file, "%s\n    \"%s\": %llu", sep, class_names[i], 
+                (long long unsigned)profile->class_counts[i]);
+        sep = ",";
+    }
+
+    fprintf(file, "\n  },\n  \"addresses\": [");
+    sep = "";
+    for (int pc = 0; pc < 4096; pc++) {
+        if (!profile->pc_counts[pc]) continue;
+        fprintf(file, "%s\n    {\"pc\": %d, \"opcode\": \"%04X\", \"count\": %llu}", sep, pc,
+                profile->pc_opcode[pc], (long long unsigned)profile->pc_counts[pc]);
+        sep = ",";
+    }
+
+    fprintf(file, "\n  ],\n  \"frame_instructions\": {");
+    sep = "";
+    for (int i = 0; i <= PROFILE_MAX_FRAME_INSTS; i++) {
+        if (!profile->frame_insts[i]) continue;
+        fprintf(file, "%s\n    \"%d\": %llu", sep, i, (long long unsigned)profile->frame_insts[i]);
+        sep = ",";
+    }
+    fprintf(file, "\n  }\n}\n");
+
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static int bit_length(uint64_t value) {
+    int bits = 0;
+    for (; value; value >>= 1) bits++;
+    return bits;
+}
+
+// 64x64 grayscale PGM, one pixel per address, row major from 0x000. Brightness is log2 
+//   scaled so cold code still shows up next to the hot loop.
+bool profile_write_heatmap(const profile_t *profile, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", filename);
+        return false;
+    }
+
+    uint64_t max = 0;
+    for (int pc = 0; pc < 4096; pc++) 
+        if (profile->pc_counts[pc] > max) max = profile->pc_counts[pc];
+    const int max_bits = bit_length(max);
+
+    uint8_t pixels[4096];
+    for (int pc = 0; pc < 4096; pc++) 
+        pixels[pc] = max_bits ? bit_length(profile->pc_counts[pc]) * 255 / max_bits : 0;
+
+    fprintf(file, "P5\n64 64\n255\n");
+    fwrite(pixels, 1, sizeof pixels, file);
+
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Print the report and write <rom>.profile.json and <rom>.heatmap.pgm to the working directory
+bool profile_dump(const profile_t *profile, const char *rom_name) {
+    const char *base = rom_name;
+    for (const char *p = rom_name; *p; p++) 
+        if (*p == '/' || *p == '\\') base = p + 1;
+
+    printf("\n==== Profile: %s ====\n", base);
+    profile_report(profile, stdout);
+
+    char filename[FILENAME_MAX];
+    snprintf(filename, sizeof filename, "%s.profile.json", base);
+    bool ok = profile_write_json(profile, filename);
+    snprintf(filename, sizeof filename, "%s.heatmap.pgm", base);
+    ok &= profile_write_heatmap(profile, filename);
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Opcode/address profiler, compiled in with -DPROFILE. Counts every executed instruction
+//   by opcode class and by address, and instructions and host time per frame. Without 
+//   PROFILE none of this is referenced by the core, so it costs nothing.
+
+#include "chip8.h"
+
+#define PROFILE_MAX_FRAME_INSTS 1024    // Frames with more instructions go in the last bucket
+
+// Opcode classes, one per CHIP8 instruction
+typedef enum {
+    OP_00E0, OP_00EE, OP_0NNN, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+    OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE,
+    OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1, 
+    OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+    OP_UNKNOWN,
+    OP_CLASS_COUNT,
+} opcode_class_t;
+
+struct profile {
+    uint64_t class_counts[OP_CLASS_COUNT];
+    uint64_t pc_counts[4096];
+    uint16_t pc_opcode[4096];       // Last opcode executed at each address
+    uint64_t frame_insts[PROFILE_MAX_FRAME_INSTS + 1];  // Histogram of instructions per frame
+    uint64_t frames;
+    uint64_t insts;
+    uint64_t frame_ns;              // Host time spent emulating frames
+};
+
+opcode_class_t opcode_class(const uint16_t opcode);
+const char *opcode_class_name(const opcode_class_t op_class);
+
+// Count 1 instruction at pc
+static inline void profile_instruction(profile_t *profile, const uint16_t pc, const uint16_t opcode) {
+    profile->class_counts[opcode_class(opcode)]++;
+    profile->pc_counts[pc & 0xFFF]++;
+    profile->pc_opcode[pc & 0xFFF] = opcode;
+}
+
+// Count 1 frame of insts instructions that took ns of host time
+static inline void profile_frame(profile_t *profile, const uint32_t insts, const uint64_t ns) {
+    profile->frame_insts[insts < PROFILE_MAX_FRAME_INSTS ? insts : PROFILE_MAX_FRAME_INSTS]++;
+    profile->frames++;
+    profile->insts += insts;
+    profile->frame_ns += ns;
+}
+
+void profile_report(const profile_t *profile, FILE *out);
+bool profile_write_json(const profile_t *profile, const char *filename);
+bool profile_write_heatmap(const profile_t *profile, const char *filename);
+bool profile_dump(const profile_t *profile, const char *rom_name);
+
+#endif // PROFILE_H
@@ -0,0 +1,52 @@
+#include "quirkdb.h"
+
+// Known ROMs. Each entry lives in slot (sha1[0] % QUIRKDB_SLOTS), or the next free slot 
+//   after it when that one is taken, wrapping around.
+static const quirk_entry_t quirk_db[QUIRKDB_SLOTS] = {
+    // 6-keypad.ch8 (Timendus test suite)
+    [0x05] = {{0x45, 0x5b, 0x9f, 0xc6, 0x9c, 0xc0, 0x6e, 0x2b}, CHIP8, KEYPAD_QWERTY, 10},
+    // 4-flags.ch8
+    [0x15] = {{0x55, 0xa6, 0x71, 0x6d, 0xac, 0xc2, 0xf9, 0x3d}, CHIP8, KEYPAD_QWERTY, 10},
+    // IBM_Logo.ch8
+    [0x1b] = {{0x1b, 0xa5, 0x86, 0x56, 0x81, 0x0b, 0x67, 0xfd}, CHIP8, KEYPAD_QWERTY, 10},
+    // BC_test.ch8
+    [0x1d] = {{0x9d, 0xf1, 0x68, 0x90, 0x15, 0xa0, 0xd1, 0xd9}, CHIP8, KEYPAD_QWERTY, 10},
+    // TETRIS (Fran Dachille): 4 rotates, 5/6 move left/right, 7 drops
+    [0x1f] = {{0x5f, 0x51, 0x80, 0x84, 0x74, 0x4b, 0xf3, 0xcb}, CHIP8, KEYPAD_ARROWS_TETRIS, 10},
+    // 5-quirks.ch8, asks which platform to test; plain CHIP-8 is what we emulate by default
+    [0x22] = {{0xe2, 0x14, 0x9c, 0xb8, 0x36, 0x13, 0x1a, 0x14}, CHIP8, KEYPAD_QWERTY, 10},
+    // 1-chip8-logo.ch8
+    [0x30] = {{0x30, 0xf2, 0x7e, 0x5c, 0xee, 0x5b, 0x32, 0x5f}, CHIP8, KEYPAD_QWERTY, 10},
+    // 7-beep.ch8
+    [0x31] = {{0xb1, 0x19, 0x65, 0x1b, 0x5a, 0xa0, 0x85, 0x57}, CHIP8, KEYPAD_QWERTY, 10},
+    // 3-corax+.ch8
+    [0x32] = {{0xb2, 0xda, 0xcf, 0x6d, 0x85, 0x78, 0x5d, 0x6c}, CHIP8, KEYPAD_QWERTY, 10},
+    // test_opcode.ch8 (home slot 0x31)
+    [0x33] = {{0xf1, 0xcf, 0xcf, 0xfe, 0x19, 0x37, 0xed, 0x6d}, CHIP8, KEYPAD_QWERTY, 10},
+    // 2-ibm-logo.ch8
+    [0x39] = {{0xb9, 0xbb, 0xc1, 0x2c, 0xee, 0x3f, 0x7b, 0x9d}, CHIP8, KEYPAD_QWERTY, 10},
+};
+
+// Find a ROM in the database, NULL if it's not there
+const quirk_entry_t *quirkdb_lookup(const uint8_t sha1[SHA1_SIZE]) {
+    for (uint32_t i = 0; i < QUIRKDB_SLOTS; i++) {
+        const quirk_entry_t *entry = &quirk_db[(sha1[0] + i) & (QUIRKDB_SLOTS - 1)];
+        if (entry->insts_per_frame == 0) return NULL;   // Hit an empty slot, not in the table
+        if (memcmp(entry->sha1_prefix, sha1, QUIRKDB_PREFIX_SIZE) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Set quirks, speed and keypad layout for a known ROM, unless turned off on the command line.
+//   Options the user gave (config->given) are kept. Returns true if the ROM was found.
+bool quirkdb_apply(config_t *config, const rom_t *rom) {
+    if (!config->quirk_db) return false;
+
+    const quirk_entry_t *entry = quirkdb_lookup(rom->sha1);
+    if (!entry) return false;
+
+    if (!(config->given & GIVEN_QUIRKS)) config->current_extension = (extension_t)entry->extension;
+    if (!(config->given & GIVEN_IPS)) config->insts_per_second = entry->insts_per_frame * 60;
+    config->keypad_layout = (keypad_layout_t)entry->keypad_layout;
+    return true;
+}
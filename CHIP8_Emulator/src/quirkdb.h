@@ -0,0 +1,23 @@
+#ifndef QUIRKDB_H
+#define QUIRKDB_H
+
+// ROM quirk database: known ROMs by SHA-1, with the quirks profile, speed and keypad layout
+//   they need. The table is compiled in, so a lookup is one or two probes at load time.
+
+#include "chip8.h"
+#include "sha1.h"
+
+#define QUIRKDB_SLOTS 64        // Power of 2, keep it well above the number of entries
+#define QUIRKDB_PREFIX_SIZE 8   // Leading SHA-1 bytes stored per entry
+
+typedef struct {
+    uint8_t sha1_prefix[QUIRKDB_PREFIX_SIZE];
+    uint8_t extension;          // extension_t
+    uint8_t keypad_layout;      // keypad_layout_t
+    uint16_t insts_per_frame;   // Recommended speed, 0 marks an empty slot
+} quirk_entry_t;
+
+const quirk_entry_t *quirkdb_lookup(const uint8_t sha1[SHA1_SIZE]);
+bool quirkdb_apply(config_t *config, const rom_t *rom);
+
+#endif // QUIRKDB_H
@@ -0,0 +1,119 @@
+#include "render.h"
+
+// Clear screen / SDL Window to background color
+void clear_screen(const sdl_t sdl, const config_t config) {
+    const uint8_t r = (config.bg_color >> 24) & 0xFF;
+    const uint8_t g = (config.bg_color >> 16) & 0xFF;
+    const uint8_t b = (config.bg_color >>  8) & 0xFF;
+    const uint8_t a = (config.bg_color >>  0) & 0xFF;
+
+    SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
+    SDL_RenderClear(sdl.renderer);
+}
+
+// Update window with any changes
+void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8) {
+    SDL_Rect rect = {.x = 0, .y = 0, .w = config.scale_factor, .h = config.scale_factor};
+
+    // Grab bg color values to draw outlines
+    const uint8_t bg_r = (config.bg_color >> 24) & 0xFF;
+    const uint8_t bg_g = (config.bg_color >> 16) & 0xFF;
+    const uint8_t bg_b = (config.bg_color >>  8) & 0xFF;
+    const uint8_t bg_a = (config.bg_color >>  0) & 0xFF;
+
+    // Loop through display pixels, draw a rectangle per pixel to the SDL window
+    for (uint32_t i = 0; i < sizeof chip8->display; i++) {
+        // Translate 1D index i value to 2D X/Y coordinates
+        // X = i % window width
+        // Y = i / window width
+        rect.x = (i % config.window_width) * config.scale_factor;
+        rect.y = (i / config.window_width) * config.scale_factor;
+
+        if (chip8->display[i]) {
+            // Pixel is on, draw foreground color
+            if (chip8->pixel_color[i] != config.fg_color) {
+                // Lerp towards fg_color
+                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i], 
+                                                   config.fg_color, 
+                                                   config.color_lerp_rate);
+            }
+
+            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
+            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
+            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
+            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
+
+            SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
+            SDL_RenderFillRect(sdl.renderer, &rect);
+        
+            // TODO: Move this outside if/else, and combine lerping or at least reduce duplicate code
+            if (config.pixel_outlines) {
+                // If user requested drawing pixel outlines, draw those here
+                SDL_SetRenderDrawColor(sdl.renderer, bg_r, bg_g, bg_b, bg_a);
+                SDL_RenderDrawRect(sdl.renderer, &rect);
+            }
+
+        } else {
+            // Pixel is off, draw background color
+            if (chip8->pixel_color[i] != config.bg_color) {
+                // Lerp towards bg_color
+                chip8->pixel_color[i] = color_lerp(chip8->pixel_color[i], 
+                                                   config.bg_color, 
+                                                   config.color_lerp_rate);
+            }
+
+            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
+            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
+            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
+            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
+
+            SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
+            SDL_RenderFillRect(sdl.renderer, &rect);
+        }
+    }
+}
+
+// Draw a decimal number with the CHIP8 font sprites at x,y, returns the x after it
+int draw_number(const sdl_t sdl, const uint8_t *font, uint64_t number, int x, const int y, const int size) {
+    char digits[21];
+    const int len = snprintf(digits, sizeof digits, "%llu", (long long unsigned)number);
+
+    for (int d = 0; d < len; d++, x += 5 * size) {
+        const uint8_t *sprite = &font[(digits[d] - '0') * 5];
+        for (int row = 0; row < 5; row++) 
+            for (int col = 0; col < 4; col++) {
+                if (!(sprite[row] & (0x80 >> col))) continue;
+                const SDL_Rect rect = {x + col * size, y + row * size, size, size};
+                SDL_RenderFillRect(sdl.renderer, &rect);
+            }
+    }
+    return x;
+}
+
+// Frame timing overlay, one number per row from the top left:
+//   MIPS, FPS, then p99 microseconds for input, emulate, timers, snapshot, render, present 
+//   and the whole frame, then frames dropped in the last window and audio latency in microseconds
+void draw_stats_overlay(const sdl_t sdl, const config_t config, const chip8_t *chip8, 
+                        const telemetry_t *telemetry) {
+    const int size = config.scale_factor / 5 > 2 ? config.scale_factor / 5 : 2;
+    const phase_t phases[] = {PHASE_INPUT, PHASE_EMULATE, PHASE_TIMERS, PHASE_SNAPSHOT, 
+                              PHASE_RENDER, PHASE_PRESENT, PHASE_FRAME};
+    uint64_t rows[2 + sizeof phases / sizeof phases[0] + 2];
+    int n = 0;
+
+    rows[n++] = (uint64_t)(telemetry->mips + 0.5);
+    rows[n++] = (uint64_t)(telemetry->fps + 0.5);
+    for (size_t i = 0; i < sizeof phases / sizeof phases[0]; i++) 
+        rows[n++] = telemetry->stats[phases[i]].p99 / 1000;
+    rows[n++] = telemetry->dropped;
+    rows[n++] = telemetry->audio_latency_us;
+
+    // Dark box behind the numbers, then the numbers on top
+    SDL_SetRenderDrawColor(sdl.renderer, 0, 0, 0, 0xFF);
+    const SDL_Rect box = {0, 0, 5 * size * 8 + size, 7 * size * n + size};
+    SDL_RenderFillRect(sdl.renderer, &box);
+
+    SDL_SetRenderDrawColor(sdl.renderer, 0xFF, 0xFF, 0x00, 0xFF);
+    for (int i = 0; i < n; i++) 
+        draw_number(sdl, chip8->rom->image, rows[i], size, size + i * 7 * size, size);
+}
@@ -0,0 +1,26 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+// SDL rendering of the CHIP8 display and the frame timing overlay, shared by the frontend 
+//   and the benchmarks
+
+#include <SDL2/SDL.h>
+
+#include "chip8.h"
+#include "telemetry.h"
+
+// SDL Container object
+typedef struct {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_AudioSpec want, have;
+    SDL_AudioDeviceID dev;
+} sdl_t;
+
+void clear_screen(const sdl_t sdl, const config_t config);
+void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8);
+int draw_number(const sdl_t sdl, const uint8_t *font, uint64_t number, int x, const int y, const int size);
+void draw_stats_overlay(const sdl_t sdl, const config_t config, const chip8_t *chip8, 
+                        const telemetry_t *telemetry);
+
+#endif // RENDER_H
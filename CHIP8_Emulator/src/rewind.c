@@ -0,0 +1,221 @@
+#include "rewind.h"
+
+// Encoded snapshots are a sequence of runs over the XOR of the snapshot and its reference.
+//   Each run starts with a control byte: bit 7 set for a literal run (XOR bytes follow),
+//   clear for a zero run (bytes equal to the reference). The low 7 bits are the run length, 
+//   or 0x7F to read a 16 bit little endian length from the next 2 bytes.
+#define RUN_LITERAL 0x80
+#define RUN_LONG 0x7F
+
+// Snapshot the machine's architectural state into a fixed size raw buffer
+static void snapshot_raw(const chip8_t *chip8, uint8_t *raw) {
+    serialize_header(chip8, raw);
+    memcpy(&raw[CHIP8_STATE_HEADER_SIZE], chip8->ram, CHIP8_RAM_SIZE);
+}
+
+static size_t put_run(uint8_t *out, const uint8_t type, const uint32_t len) {
+    if (len < RUN_LONG) {
+        out[0] = type | len;
+        return 1;
+    }
+    out[0] = type | RUN_LONG;
+    out[1] = len & 0xFF;
+    out[2] = len >> 8;
+    return 3;
+}
+
+// Run length encode raw XOR ref into out, returns the encoded size
+static size_t encode(const uint8_t *raw, const uint8_t *ref, uint8_t *out) {
+    size_t pos = 0;
+    uint32_t i = 0;
+
+    while (i < REWIND_RAW_SIZE) {
+        // Zero run, skipping equal 8 byte words at a time
+        uint32_t start = i;
+        while (i + 8 <= REWIND_RAW_SIZE && memcmp(&raw[i], &ref[i], 8) == 0) i += 8;
+        while (i < REWIND_RAW_SIZE && raw[i] == ref[i]) i++;
+        if (i == REWIND_RAW_SIZE) break;    // Trailing zeros are implied
+        if (i > start) pos += put_run(&out[pos], 0, i - start);
+
+        // Literal run, until 2 equal bytes in a row
+        start = i;
+        while (i < REWIND_RAW_SIZE && 
+               (raw[i] != ref[i] || (i + 1 < REWIND_RAW_SIZE && raw[i + 1] != ref[i + 1]))) 
+            i++;
+        pos += put_run(&out[pos], RUN_LITERAL, i - start);
+        for (uint32_t j = start; j < i; j++)
+            out[pos++] = raw[j] ^ ref[j];
+    }
+
+    return pos;
+}
+
+// Decode into raw, which must already hold a copy of the reference
+static void decode(const uint8_t *in, const size_t size, uint8_t *raw) {
+    size_t pos = 0;
+    uint32_t i = 0;
+
+    while (pos < size) {
+        const uint8_t control = in[pos++];
+        uint32_t len = control & RUN_LONG;
+        if (len == RUN_LONG) {
+            len = in[pos] | (in[pos + 1] << 8);
+            pos += 2;
+        }
+
+        if (control & RUN_LITERAL) 
+            for (uint32_t j = 0; j < len; j++)
+                raw[i++] ^= in[pos++];
+        else
+            i += len;
+    }
+}
+
+// Set up the snapshot ring, arena_size bytes of encoded snapshots and up to max_frames
+//   snapshots, whichever runs out first
+bool rewind_init(rewind_t *rewind, const rom_t *rom, const uint32_t arena_size, const uint32_t max_frames) {
+    memset(rewind, 0, sizeof *rewind);
+
+    uint32_t entries = 1;
+    while (entries < max_frames) entries <<= 1;
+
+    rewind->arena = malloc(arena_size);
+    rewind->entries = malloc(entries * sizeof *rewind->entries);
+    if (!rewind->arena || !rewind->entries || arena_size < REWIND_MAX_ENCODED_SIZE) {
+        rewind_free(rewind);
+        return false;
+    }
+    rewind->arena_size = arena_size;
+    rewind->entries_mask = entries - 1;
+
+    // Keyframes reference a freshly booted machine, so they only hold what changed since boot
+    chip8_t boot = {.rom = rom};
+    memcpy(boot.ram, rom->image, CHIP8_RAM_SIZE);
+    boot.PC = CHIP8_ENTRY_POINT;
+    snapshot_raw(&boot, rewind->base_raw);
+
+    return true;
+}
+
+void rewind_free(rewind_t *rewind) {
+    free(rewind->arena);
+    free(rewind->entries);
+    rewind->arena = NULL;
+    rewind->entries = NULL;
+}
+
+// Drop all snapshots, e.g. after loading a save state
+void rewind_clear(rewind_t *rewind) {
+    rewind->oldest = rewind->next = 0;
+    rewind->write_pos = 0;
+    rewind->key_valid = false;
+}
+
+uint64_t rewind_frames(const rewind_t *rewind) {
+    return rewind->next - rewind->oldest;
+}
+
+static rewind_entry_t *entry(const rewind_t *rewind, const uint64_t seq) {
+    return &rewind->entries[seq & rewind->entries_mask];
+}
+
+// Drop the oldest snapshot, along with any snapshots left without their keyframe
+static void drop_oldest(rewind_t *rewind) {
+    do {
+        rewind->oldest++;
+    } while (rewind->oldest < rewind->next && entry(rewind, rewind->oldest)->key_distance != 0);
+
+    if (rewind->key_valid && rewind->key_seq < rewind->oldest) 
+        rewind->key_valid = false;
+}
+
+// Make room for size bytes at the arena write position, wrapping to the start if needed
+static uint32_t reserve(rewind_t *rewind, const uint32_t size) {
+    if (rewind->write_pos + size > rewind->arena_size) rewind->write_pos = 0;
+
+    const uint32_t start = rewind->write_pos, end = start + size;
+    while (rewind->oldest < rewind->next) {
+        const rewind_entry_t *oldest = entry(rewind, rewind->oldest);
+        if (oldest->offset + oldest->size <= start || oldest->offset >= end) break;
+        drop_oldest(rewind);
+    }
+
+    rewind->write_pos = end;
+    return start;
+}
+
+// Snapshot the current frame
+bool rewind_push(rewind_t *rewind, const chip8_t *chip8) {
+    uint8_t *raw = rewind->raw;
+    uint8_t *encoded = rewind->encoded;
+    snapshot_raw(chip8, raw);
+
+    // Delta against the current keyframe, or start a new keyframe
+    const bool keyframe = !rewind->key_valid || 
+                          rewind->next - rewind->key_seq >= REWIND_KEYFRAME_INTERVAL;
+    const size_t size = encode(raw, keyframe ? rewind->base_raw : rewind->key_raw, encoded);
+
+    if (rewind->next - rewind->oldest > rewind->entries_mask) drop_oldest(rewind);
+    const uint32_t offset = reserve(rewind, (uint32_t)size);
+    memcpy(&rewind->arena[offset], encoded, size);
+
+    // A delta whose keyframe was just evicted can't be decoded, start over with a keyframe
+    if (!keyframe && !rewind->key_valid) {
+        rewind->write_pos = offset;
+        return rewind_push(rewind, chip8);
+    }
+
+    *entry(rewind, rewind->next) = (rewind_entry_t){
+        .offset = offset,
+        .size = (uint16_t)size,
+        .key_distance = keyframe ? 0 : (uint16_t)(rewind->next - rewind->key_seq),
+    };
+
+    if (keyframe) {
+        memcpy(rewind->key_raw, raw, REWIND_RAW_SIZE);
+        rewind->key_seq = rewind->next;
+        rewind->key_valid = true;
+    }
+    rewind->next++;
+    return true;
+}
+
+// Restore the snapshot before the newest one and drop the newest. Host keypad state is kept.
+//   Returns false once there is nothing left to rewind to.
+bool rewind_step_back(rewind_t *rewind, chip8_t *chip8) {
+    if (rewind->next - rewind->oldest < 2) return false;
+
+    // Drop newest, reclaiming its arena space
+    rewind->next--;
+    rewind->write_pos = entry(rewind, rewind->next)->offset;
+    if (rewind->key_valid && rewind->key_seq >= rewind->next) 
+        rewind->key_valid = false;
+
+    const uint64_t seq = rewind->next - 1;
+    const rewind_entry_t *target = entry(rewind, seq);
+    const uint64_t key_seq = seq - target->key_distance;
+
+    // Decode the keyframe if it isn't cached already
+    if (!rewind->key_valid || rewind->key_seq != key_seq) {
+        const rewind_entry_t *key = entry(rewind, key_seq);
+        memcpy(rewind->key_raw, rewind->base_raw, REWIND_RAW_SIZE);
+        decode(&rewind->arena[key->offset], key->size, rewind->key_raw);
+        rewind->key_seq = key_seq;
+        rewind->key_valid = true;
+    }
+
+    uint8_t *raw = rewind->raw;
+    memcpy(raw, rewind->key_raw, REWIND_RAW_SIZE);
+    if (target->key_distance) decode(&rewind->arena[target->offset], target->size, raw);
+
+    bool keypad[16];
+    memcpy(keypad, chip8->keypad, sizeof keypad);
+
+    deserialize_header(chip8, raw);
+    memcpy(chip8->ram, &raw[CHIP8_STATE_HEADER_SIZE], CHIP8_RAM_SIZE);
+    sync_ram_guard(chip8);
+    memcpy(chip8->keypad, keypad, sizeof keypad);
+    chip8->draw = true;
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+// Frame granular rewind: every frame is snapshotted into a fixed size ring. Keyframes are
+//   stored as an XOR against the ROM boot image and the frames between them as an XOR 
+//   against their keyframe, both run length encoded, so most frames take a few bytes.
+
+#include "chip8.h"
+
+#define REWIND_RAW_SIZE (CHIP8_STATE_HEADER_SIZE + 4096)    // Header + full RAM
+#define REWIND_KEYFRAME_INTERVAL 60     // Frames between keyframes, 1 second
+#define REWIND_MAX_ENCODED_SIZE (REWIND_RAW_SIZE + (REWIND_RAW_SIZE / 2 + 1) * 3)
+
+// Snapshot index entry
+typedef struct {
+    uint32_t offset;        // Offset of encoded snapshot in the arena
+    uint16_t size;          // Encoded size in bytes
+    uint16_t key_distance;  // Frames back to this snapshot's keyframe, 0 for keyframes
+} rewind_entry_t;
+
+typedef struct {
+    uint8_t *arena;         // Encoded snapshots, used as a ring
+    uint32_t arena_size;
+    uint32_t write_pos;     // Next free byte in the arena
+
+    rewind_entry_t *entries;    // Snapshot index ring
+    uint32_t entries_mask;      // Number of entries - 1, a power of 2
+    uint64_t oldest;            // Sequence number of the oldest snapshot
+    uint64_t next;              // Sequence number of the next snapshot to push
+
+    uint8_t base_raw[REWIND_RAW_SIZE];  // Boot image snapshot, reference for keyframes
+    uint8_t key_raw[REWIND_RAW_SIZE];   // Decoded snapshot of the newest keyframe in use
+    uint64_t key_seq;                   // Sequence number of the snapshot in key_raw
+    bool key_valid;
+
+    uint8_t raw[REWIND_RAW_SIZE];       // Scratch space for snapshotting/restoring
+    uint8_t encoded[REWIND_MAX_ENCODED_SIZE];
+} rewind_t;
+
+bool rewind_init(rewind_t *rewind, const rom_t *rom, const uint32_t arena_size, const uint32_t max_frames);
+void rewind_free(rewind_t *rewind);
+void rewind_clear(rewind_t *rewind);
+bool rewind_push(rewind_t *rewind, const chip8_t *chip8);
+bool rewind_step_back(rewind_t *rewind, chip8_t *chip8);
+uint64_t rewind_frames(const rewind_t *rewind);
+
+#endif // REWIND_H
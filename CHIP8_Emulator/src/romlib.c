@@ -0,0 +1,360 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "romlib.h"
+
+#define INDEX_HEADER "# CHIP8 ROM index v1: sha1 size mtime flags path"
+
+// Read-only memory mapping of a whole file
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} mapped_file_t;
+
+static bool map_file(mapped_file_t *map, const char *path) {
+    memset(map, 0, sizeof *map);
+
+#ifdef _WIN32
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(map->file, &size) || size.QuadPart == 0) {
+        CloseHandle(map->file);
+        return false;
+    }
+    map->size = (size_t)size.QuadPart;
+
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!map->mapping) {
+        CloseHandle(map->file);
+        return false;
+    }
+    map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return false;
+    }
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    map->size = (size_t)st.st_size;
+
+    void *data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping stays valid after closing the file
+    if (data == MAP_FAILED) return false;
+    map->data = data;
+#endif
+
+    return true;
+}
+
+static void unmap_file(mapped_file_t *map) {
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void *)map->data, map->size);
+#endif
+    map->data = NULL;
+}
+
+// Build the boot RAM image for ROM bytes already in memory
+bool load_rom_bytes(rom_t *rom, const char rom_name[], const uint8_t *data, const size_t size) {
+    const uint32_t entry_point = CHIP8_ENTRY_POINT; // CHIP8 Roms will be loaded to 0x200
+    const uint8_t font[] = {
+        0xF0, 0x90, 0x90, 0x90, 0xF0,   // 0   
+        0x20, 0x60, 0x20, 0x20, 0x70,   // 1  
+        0xF0, 0x10, 0xF0, 0x80, 0xF0,   // 2 
+        0xF0, 0x10, 0xF0, 0x10, 0xF0,   // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10,   // 4    
+        0xF0, 0x80, 0xF0, 0x10, 0xF0,   // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0,   // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40,   // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0,   // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0,   // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90,   // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0,   // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0,   // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0,   // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0,   // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80,   // F
+    };
+
+    // Check rom size
+    const size_t max_size = sizeof rom->image - entry_point;
+    if (size > max_size) {
+        fprintf(stderr, "Rom file %s is too big! Rom size: %llu, Max size allowed: %llu\n", 
+                rom_name, (long long unsigned)size, (long long unsigned)max_size);
+        return false;
+    }
+
+    memset(rom, 0, sizeof *rom);
+
+    // Load font and ROM
+    memcpy(&rom->image[0], font, sizeof(font));
+    if (size) memcpy(&rom->image[entry_point], data, size);
+
+    rom->name = rom_name;
+    rom->size = (uint32_t)size;
+    rom->hash = fnv1a_hash(&rom->image[entry_point], size);
+    sha1(&rom->image[entry_point], size, rom->sha1);
+
+    return true;    // Success
+}
+
+// Load ROM file and build its boot RAM image
+bool load_rom(rom_t *rom, const char rom_name[]) {
+    // Map ROM file
+    mapped_file_t map;
+    if (!map_file(&map, rom_name)) {
+        fprintf(stderr, "Rom file %s is invalid or does not exist\n", rom_name);
+        return false;
+    }
+
+    const bool ok = load_rom_bytes(rom, rom_name, map.data, map.size);
+    unmap_file(&map);
+    return ok;
+}
+
+// Detect ROM features by scanning every aligned opcode. Data bytes are scanned too, 
+//   so these are hints, not guarantees.
+uint32_t detect_rom_flags(const rom_t *rom) {
+    uint32_t flags = 0;
+
+    for (uint32_t pc = CHIP8_ENTRY_POINT; pc + 1 < CHIP8_ENTRY_POINT + rom->size; pc += 2) {
+        const uint16_t opcode = (rom->image[pc] << 8) | rom->image[pc + 1];
+        const uint8_t NN = opcode & 0xFF;
+
+        switch (opcode >> 12) {
+            case 0x0:
+                if ((opcode & 0xFFF0) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF)) 
+                    flags |= ROM_USES_SUPERCHIP;
+                break;
+            case 0x5:
+                if ((opcode & 0xF) == 2 || (opcode & 0xF) == 3) flags |= ROM_USES_XOCHIP;
+                break;
+            case 0xC:
+                flags |= ROM_USES_RANDOM;
+                break;
+            case 0xE:
+                if (NN == 0x9E || NN == 0xA1) flags |= ROM_USES_KEYPAD;
+                break;
+            case 0xF:
+                if (NN == 0x18) flags |= ROM_USES_SOUND;
+                if (NN == 0x0A) flags |= ROM_USES_KEY_WAIT;
+                if (NN == 0x30 || NN == 0x75 || NN == 0x85) flags |= ROM_USES_SUPERCHIP;
+                if (opcode == 0xF000 || opcode == 0xF002 || NN == 0x01 || NN == 0x3A) 
+                    flags |= ROM_USES_XOCHIP;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return flags;
+}
+
+static uint32_t path_hash(const char *path) {
+    return fnv1a_hash((const uint8_t *)path, strlen(path));
+}
+
+// Find entry index for path, or the empty slot where it would go
+static uint32_t *find_slot(const rom_library_t *lib, const char *path) {
+    uint32_t i = path_hash(path) & lib->slots_mask;
+    while (lib->slots[i] && strcmp(lib->entries[lib->slots[i] - 1].path, path) != 0)
+        i = (i + 1) & lib->slots_mask;
+    return &lib->slots[i];
+}
+
+// Add a new entry for path, growing the entry array and hash table as needed
+static rom_entry_t *add_entry(rom_library_t *lib, const char *path) {
+    if (lib->count == lib->capacity) {
+        const uint32_t capacity = lib->capacity ? lib->capacity * 2 : 64;
+        rom_entry_t *entries = realloc(lib->entries, capacity * sizeof *entries);
+        if (!entries) return NULL;
+        lib->entries = entries;
+        lib->capacity = capacity;
+    }
+
+    // Keep the hash table at most half full
+    if ((lib->count + 1) * 2 > lib->slots_mask + 1) {
+        const uint32_t slots = (lib->slots_mask + 1) * 2;
+        uint32_t *table = calloc(slots, sizeof *table);
+        if (!table) return NULL;
+        free(lib->slots);
+        lib->slots = table;
+        lib->slots_mask = slots - 1;
+        for (uint32_t e = 0; e < lib->count; e++)
+            *find_slot(lib, lib->entries[e].path) = e + 1;
+    }
+
+    char *copy = malloc(strlen(path) + 1);
+    if (!copy) return NULL;
+    strcpy(copy, path);
+
+    rom_entry_t *entry = &lib->entries[lib->count++];
+    memset(entry, 0, sizeof *entry);
+    entry->path = copy;
+    *find_slot(lib, copy) = lib->count;
+    return entry;
+}
+
+// Open the ROM library, reading the on-disk index if there is one
+bool romlib_open(rom_library_t *lib, const char *index_file) {
+    memset(lib, 0, sizeof *lib);
+    lib->index_file = index_file;
+
+    lib->slots_mask = 127;
+    lib->slots = calloc(lib->slots_mask + 1, sizeof *lib->slots);
+    if (!lib->slots) return false;
+
+    if (!index_file) return true;
+    FILE *file = fopen(index_file, "r");
+    if (!file) return true;     // No index yet
+
+    char line[FILENAME_MAX + 128];
+    while (fgets(line, sizeof line, file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        uint8_t digest[SHA1_SIZE];
+        unsigned long size, flags;
+        long long mtime;
+        int path_start = 0;
+        if (sha1_from_hex(line, digest) != SHA1_SIZE * 2 ||
+            sscanf(&line[SHA1_SIZE * 2], " %lu %lld %lx %n", &size, &mtime, &flags, &path_start) != 3 ||
+            path_start == 0) 
+            continue;   // Skip malformed lines
+
+        const char *path = &line[SHA1_SIZE * 2 + path_start];
+        rom_entry_t *entry = *find_slot(lib, path) ? &lib->entries[*find_slot(lib, path) - 1] : 
+                                                     add_entry(lib, path);
+        if (!entry) break;
+        memcpy(entry->sha1, digest, SHA1_SIZE);
+        entry->size = (uint32_t)size;
+        entry->mtime = mtime;
+        entry->flags = (uint32_t)flags;
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Get the library entry for a ROM file. If the index already has it with the same size 
+//   and modification time, this costs a stat() and no reads.
+const rom_entry_t *romlib_scan(rom_library_t *lib, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Rom file %s is invalid or does not exist\n", path);
+        return NULL;
+    }
+
+    const uint32_t index = *find_slot(lib, path);
+    rom_entry_t *entry = index ? &lib->entries[index - 1] : add_entry(lib, path);
+    if (!entry) return NULL;
+
+    if (index && entry->size == (uint32_t)st.st_size && entry->mtime == (int64_t)st.st_mtime)
+        return entry;
+
+    // New or changed file, (re)load and hash it
+    if (!entry->rom) entry->rom = malloc(sizeof *entry->rom);
+    if (!entry->rom || !load_rom(entry->rom, entry->path)) {
+        free(entry->rom);
+        entry->rom = NULL;
+        return NULL;
+    }
+
+    memcpy(entry->sha1, entry->rom->sha1, SHA1_SIZE);
+    entry->size = entry->rom->size;
+    entry->mtime = (int64_t)st.st_mtime;
+    entry->flags = detect_rom_flags(entry->rom);
+    lib->dirty = true;
+
+    return entry;
+}
+
+// Get the boot image for a ROM file, loading it only the first time
+const rom_t *romlib_load(rom_library_t *lib, const char *path) {
+    rom_entry_t *entry = (rom_entry_t *)romlib_scan(lib, path);
+    if (!entry) return NULL;
+
+    if (!entry->rom) {
+        entry->rom = malloc(sizeof *entry->rom);
+        if (!entry->rom || !load_rom(entry->rom, entry->path)) {
+            free(entry->rom);
+            entry->rom = NULL;
+            return NULL;
+        }
+
+        // File changed between the stat() and the read, refresh the index entry
+        if (memcmp(entry->sha1, entry->rom->sha1, SHA1_SIZE) != 0) {
+            memcpy(entry->sha1, entry->rom->sha1, SHA1_SIZE);
+            entry->size = entry->rom->size;
+            entry->flags = detect_rom_flags(entry->rom);
+            lib->dirty = true;
+        }
+    }
+
+    return entry->rom;
+}
+
+// Write the index, atomically so concurrent batch jobs never see a partial file
+bool romlib_save_index(rom_library_t *lib) {
+    if (!lib->index_file || !lib->dirty) return true;
+
+    size_t size = strlen(INDEX_HEADER) + 1;
+    for (uint32_t e = 0; e < lib->count; e++)
+        size += SHA1_SIZE * 2 + 64 + strlen(lib->entries[e].path);
+
+    char *buf = malloc(size);
+    if (!buf) return false;
+
+    size_t pos = sprintf(buf, "%s\n", INDEX_HEADER);
+    for (uint32_t e = 0; e < lib->count; e++) {
+        const rom_entry_t *entry = &lib->entries[e];
+        char hex[SHA1_SIZE * 2 + 1];
+        sha1_to_hex(entry->sha1, hex);
+        pos += sprintf(&buf[pos], "%s %lu %lld %lx %s\n", hex, (unsigned long)entry->size, 
+                       (long long)entry->mtime, (unsigned long)entry->flags, entry->path);
+    }
+
+    const bool ok = write_file_atomic(lib->index_file, (const uint8_t *)buf, pos);
+    free(buf);
+    if (ok) lib->dirty = false;
+    return ok;
+}
+
+// Save the index if anything changed and free all cached images
+void romlib_close(rom_library_t *lib) {
+    romlib_save_index(lib);
+
+    for (uint32_t e = 0; e < lib->count; e++) {
+        free(lib->entries[e].path);
+        free(lib->entries[e].rom);
+    }
+    free(lib->entries);
+    free(lib->slots);
+    memset(lib, 0, sizeof *lib);
+}
@@ -0,0 +1,51 @@
+#ifndef ROMLIB_H
+#define ROMLIB_H
+
+// ROM library: ROM files are memory mapped, hashed and kept in memory as ready to boot
+//   images, with an on-disk index of hash, size and detected metadata so batch runs over
+//   thousands of ROMs only touch each file once.
+
+#include "chip8.h"
+#include "sha1.h"
+
+// Metadata detected by scanning ROM opcodes
+#define ROM_USES_SOUND      (1 << 0)    // FX18
+#define ROM_USES_RANDOM     (1 << 1)    // CXNN
+#define ROM_USES_KEY_WAIT   (1 << 2)    // FX0A
+#define ROM_USES_KEYPAD     (1 << 3)    // EX9E/EXA1
+#define ROM_USES_SUPERCHIP  (1 << 4)    // 00CN/00FB-00FF/FX30/FX75/FX85
+#define ROM_USES_XOCHIP     (1 << 5)    // 5XY2/5XY3/F000/FX01/F002/FX3A
+
+// Library entry, one per ROM file
+typedef struct {
+    char *path;
+    uint8_t sha1[SHA1_SIZE];
+    uint32_t size;
+    int64_t mtime;          // File modification time when hashed
+    uint32_t flags;         // ROM_USES_* metadata
+    rom_t *rom;             // Cached boot image, loaded on first use
+} rom_entry_t;
+
+typedef struct {
+    rom_entry_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;        // Open addressing hash table of path -> entry index + 1
+    uint32_t slots_mask;
+    const char *index_file; // On-disk index, NULL for none
+    bool dirty;             // Index needs writing
+} rom_library_t;
+
+// Load ROM file and build its boot RAM image
+bool load_rom(rom_t *rom, const char rom_name[]);
+// Same from ROM bytes already in memory
+bool load_rom_bytes(rom_t *rom, const char rom_name[], const uint8_t *data, const size_t size);
+uint32_t detect_rom_flags(const rom_t *rom);
+
+bool romlib_open(rom_library_t *lib, const char *index_file);
+const rom_entry_t *romlib_scan(rom_library_t *lib, const char *path);
+const rom_t *romlib_load(rom_library_t *lib, const char *path);
+bool romlib_save_index(rom_library_t *lib);
+void romlib_close(rom_library_t *lib);
+
+#endif // ROMLIB_H
@@ -0,0 +1,105 @@
+#include "save_writer.h"
+
+// Writer thread, waits for save jobs and writes them out atomically
+static int save_writer_thread(void *data) {
+    save_writer_t *writer = (save_writer_t *)data;
+    uint8_t *buf = writer->write_buf;
+    char filename[FILENAME_MAX];
+
+    SDL_LockMutex(writer->lock);
+    for (;;) {
+        while (!writer->pending && !writer->quit) 
+            SDL_CondWait(writer->cond, writer->lock);
+
+        // Finish any pending job before quitting
+        if (!writer->pending) break;
+
+        // Take the job, so the emulator can queue the next one while we write
+        const size_t size = writer->size;
+        memcpy(buf, writer->buf, size);
+        memcpy(filename, writer->filename, sizeof filename);
+        writer->pending = false;
+        SDL_UnlockMutex(writer->lock);
+
+        const bool ok = write_file_atomic(filename, buf, size);
+
+        SDL_LockMutex(writer->lock);
+        memcpy(writer->last_filename, filename, sizeof filename);
+        if (!ok) atomic_fetch_add(&writer->failed, 1);
+        atomic_fetch_add(&writer->completed, 1);
+    }
+    SDL_UnlockMutex(writer->lock);
+
+    return 0;
+}
+
+bool save_writer_init(save_writer_t *writer) {
+    memset(writer, 0, sizeof *writer);
+
+    writer->lock = SDL_CreateMutex();
+    writer->cond = SDL_CreateCond();
+    if (!writer->lock || !writer->cond) {
+        SDL_Log("Could not create save writer lock %s\n", SDL_GetError());
+        return false;
+    }
+
+    writer->thread = SDL_CreateThread(save_writer_thread, "save writer", writer);
+    if (!writer->thread) {
+        SDL_Log("Could not create save writer thread %s\n", SDL_GetError());
+        return false;
+    }
+
+    return true;    // Success
+}
+
+// Snapshot state into memory and queue it for writing, returns immediately
+bool save_writer_submit(save_writer_t *writer, const chip8_t *chip8, const char *filename) {
+    uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    const size_t size = serialize_state(chip8, buf, sizeof buf);
+    if (size == 0) return false;
+
+    SDL_LockMutex(writer->lock);
+    memcpy(writer->buf, buf, size);
+    writer->size = size;
+    snprintf(writer->filename, sizeof writer->filename, "%s", filename);
+    writer->pending = true;
+    SDL_CondSignal(writer->cond);
+    SDL_UnlockMutex(writer->lock);
+
+    return true;
+}
+
+// Report finished saves to the user, call once per frame from the emulator thread
+void save_writer_report(save_writer_t *writer) {
+    const uint32_t completed = atomic_load(&writer->completed);
+    if (completed == writer->reported) return;
+
+    const uint32_t failed = atomic_load(&writer->failed);
+    SDL_LockMutex(writer->lock);
+    if (failed != writer->reported_failed) 
+        printf("Failed to save state to %s.\n", writer->last_filename);
+    else
+        printf("State saved successfully to %s.\n", writer->last_filename);
+    SDL_UnlockMutex(writer->lock);
+
+    writer->reported = completed;
+    writer->reported_failed = failed;
+}
+
+// Flush any pending save and stop the writer thread
+void save_writer_quit(save_writer_t *writer) {
+    if (writer->thread) {
+        SDL_LockMutex(writer->lock);
+        writer->quit = true;
+        SDL_CondSignal(writer->cond);
+        SDL_UnlockMutex(writer->lock);
+        SDL_WaitThread(writer->thread, NULL);
+        save_writer_report(writer);
+    }
+
+    if (writer->cond) SDL_DestroyCond(writer->cond);
+    if (writer->lock) SDL_DestroyMutex(writer->lock);
+    writer->thread = NULL;
+    writer->cond = NULL;
+    writer->lock = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef SAVE_WRITER_H
+#define SAVE_WRITER_H
+
+// Background save state writer: the emulator serializes state into memory, a writer
+//   thread does the file I/O so slow disks never stall a frame.
+
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+#include "chip8.h"
+
+typedef struct {
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+
+    // Pending job, protected by lock. A newer save replaces one not yet started.
+    uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    size_t size;
+    char filename[FILENAME_MAX];
+    bool pending;
+    bool quit;
+
+    uint8_t write_buf[CHIP8_STATE_MAX_SIZE];    // Job being written, writer thread only
+
+    // Completion reports, written by the writer thread
+    _Atomic uint32_t completed;     // Number of finished jobs
+    _Atomic uint32_t failed;        // Number of those that failed
+    uint32_t reported;              // Finished jobs already reported to the user (emulator side)
+    uint32_t reported_failed;
+    char last_filename[FILENAME_MAX];   // File of the last finished job, for reporting only
+} save_writer_t;
+
+bool save_writer_init(save_writer_t *writer);
+bool save_writer_submit(save_writer_t *writer, const chip8_t *chip8, const char *filename);
+void save_writer_report(save_writer_t *writer);
+void save_writer_quit(save_writer_t *writer);
+
+#endif // SAVE_WRITER_H
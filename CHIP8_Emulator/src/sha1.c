@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "sha1.h"
+
+static inline uint32_t rol(const uint32_t value, const int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// Process one 64 byte block
+static void sha1_block(uint32_t state[5], const uint8_t *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i*4] << 24) | (block[i*4+1] << 16) | (block[i*4+2] << 8) | block[i*4+3];
+    for (int i = 16; i < 80; i++)
+        w[i] = rol(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+
+        const uint32_t temp = rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// SHA-1 digest of data, used to identify ROMs by content
+void sha1(const uint8_t *data, const size_t size, uint8_t digest[SHA1_SIZE]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    size_t pos = 0;
+    for (; pos + 64 <= size; pos += 64)
+        sha1_block(state, &data[pos]);
+
+    // Final block(s): remaining bytes, 0x80, zero padding, 64 bit big endian bit length
+    uint8_t tail[128] = {0};
+    const size_t rest = size - pos;
+    memcpy(tail, &data[pos], rest);
+    tail[rest] = 0x80;
+
+    const size_t tail_size = rest < 56 ? 64 : 128;
+    const uint64_t bits = (uint64_t)size * 8;
+    for (int i = 0; i < 8; i++)
+        tail[tail_size - 1 - i] = (bits >> (8 * i)) & 0xFF;
+
+    for (size_t i = 0; i < tail_size; i += 64)
+        sha1_block(state, &tail[i]);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i*4]   = state[i] >> 24;
+        digest[i*4+1] = state[i] >> 16;
+        digest[i*4+2] = state[i] >> 8;
+        digest[i*4+3] = state[i];
+    }
+}
+
+void sha1_to_hex(const uint8_t digest[SHA1_SIZE], char hex[SHA1_SIZE * 2 + 1]) {
+    for (int i = 0; i < SHA1_SIZE; i++)
+        sprintf(&hex[i * 2], "%02x", digest[i]);
+}
+
+// Returns number of characters parsed, SHA1_SIZE * 2 on success
+int sha1_from_hex(const char *hex, uint8_t digest[SHA1_SIZE]) {
+    for (int i = 0; i < SHA1_SIZE; i++) {
+        unsigned int byte;
+        if (sscanf(&hex[i * 2], "%2x", &byte) != 1) return i * 2;
+        digest[i] = (uint8_t)byte;
+    }
+    return SHA1_SIZE * 2;
+}
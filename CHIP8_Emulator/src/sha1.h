@@ -0,0 +1,13 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA1_SIZE 20
+
+void sha1(const uint8_t *data, const size_t size, uint8_t digest[SHA1_SIZE]);
+void sha1_to_hex(const uint8_t digest[SHA1_SIZE], char hex[SHA1_SIZE * 2 + 1]);
+int sha1_from_hex(const char *hex, uint8_t digest[SHA1_SIZE]);
+
+#endif // SHA1_H
@@ -0,0 +1,290 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "chip8.h"
+
+// Save state format, all fields little endian with no padding:
+//
+//   offset  size  field
+//   0       4     magic "C8SS"
+//   4       2     format version (CHIP8_STATE_VERSION)
+//   6       2     flags, reserved (0)
+//   8       4     ROM hash (FNV-1a) the state was saved with
+//   12      2     ROM size
+//   14      2     PC
+//   16      2     I
+//   18      1     SP
+//   19      1     delay timer
+//   20      1     sound timer
+//   21      1     key FX0A is waiting on, 0xFF for none (version 2+, reserved 0 before)
+//   22      16    V0-VF
+//   38      24    stack[12]
+//   62      2     keypad, bit N = key N pressed
+//   64      8     RNG state
+//   72      256   display, 1 bit per pixel, MSB first, row major
+//   328     2     number of RAM diff runs
+//   330     ...   RAM diff runs: offset (2), length (2), bytes (length)
+//
+// RAM is stored as a diff against the ROM's boot image, so a state is usually a few 
+//   hundred bytes. Serializing never allocates and is bounded by CHIP8_STATE_MAX_SIZE.
+
+#define STATE_MAGIC "C8SS"
+#define STATE_DISPLAY_OFFSET 72
+#define STATE_FIXED_SIZE 330    // Header + display + run count
+#define RAM_BLOCK 64            // Compare RAM in blocks, only scanning blocks that differ
+#define RAM_RUN_GAP 4           // Merge runs separated by fewer equal bytes than a run header
+
+// Pack display 8 pixels per byte, MSB first
+void pack_display(const bool *display, uint8_t *packed) {
+    for (int i = 0; i < 64*32 / 8; i++) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Gather the low bit of 8 bools into the top byte with one multiply
+        uint64_t pixels;
+        memcpy(&pixels, &display[i * 8], 8);
+        packed[i] = (pixels * 0x8040201008040201ull) >> 56;
+#else
+        const bool *pixels = &display[i * 8];
+        packed[i] = (pixels[0] << 7) | (pixels[1] << 6) | (pixels[2] << 5) | (pixels[3] << 4) |
+                    (pixels[4] << 3) | (pixels[5] << 2) | (pixels[6] << 1) | pixels[7];
+#endif
+    }
+}
+
+// Unpack display from 8 pixels per byte, MSB first
+void unpack_display(const uint8_t *packed, bool *display) {
+    for (int i = 0; i < 64*32 / 8; i++) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Spread the byte to 8 lanes, keep one bit per lane and normalize it to 0/1
+        const uint64_t lanes = (packed[i] * 0x0101010101010101ull) & 0x0102040810204080ull;
+        const uint64_t pixels = ((lanes + 0x7F7F7F7F7F7F7F7Full) >> 7) & 0x0101010101010101ull;
+        memcpy(&display[i * 8], &pixels, 8);
+#else
+        for (int j = 0; j < 8; j++)
+            display[i * 8 + j] = (packed[i] >> (7 - j)) & 1;
+#endif
+    }
+}
+
+// Write the fixed size state header (everything but RAM), CHIP8_STATE_HEADER_SIZE bytes
+void serialize_header(const chip8_t *chip8, uint8_t *buf) {
+    memcpy(&buf[0], STATE_MAGIC, 4);
+    put_u16(&buf[4], CHIP8_STATE_VERSION);
+    put_u16(&buf[6], 0);
+    put_u32(&buf[8], chip8->rom->hash);
+    put_u16(&buf[12], (uint16_t)chip8->rom->size);
+    put_u16(&buf[14], chip8->PC);
+    put_u16(&buf[16], chip8->I);
+    buf[18] = chip8->SP;
+    buf[19] = chip8->delay_timer;
+    buf[20] = chip8->sound_timer;
+    buf[21] = chip8->wait_key;
+    memcpy(&buf[22], chip8->V, 16);
+    for (int i = 0; i < 12; i++)
+        put_u16(&buf[38 + i * 2], chip8->stack[i]);
+
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++)
+        keys |= chip8->keypad[i] << i;
+    put_u16(&buf[62], keys);
+
+    put_u64(&buf[64], chip8->rng);
+
+    pack_display(chip8->display, &buf[STATE_DISPLAY_OFFSET]);
+}
+
+// Read the fixed size state header back into the machine, the header must already be validated
+void deserialize_header(chip8_t *chip8, const uint8_t *buf) {
+    chip8->PC = get_u16(&buf[14]);
+    chip8->I = get_u16(&buf[16]);
+    chip8->SP = buf[18];
+    chip8->delay_timer = buf[19];
+    chip8->sound_timer = buf[20];
+    memcpy(chip8->V, &buf[22], 16);
+    for (int i = 0; i < 12; i++)
+        chip8->stack[i] = get_u16(&buf[38 + i * 2]);
+
+    const uint16_t keys = get_u16(&buf[62]);
+    for (int i = 0; i < 16; i++)
+        chip8->keypad[i] = (keys >> i) & 1;
+
+    chip8->rng = get_u64(&buf[64]);
+
+    // Version 1 states were saved while FX0A kept its key in a static, start waiting afresh
+    chip8->wait_key = get_u16(&buf[4]) >= 2 ? buf[21] : 0xFF;
+
+    unpack_display(&buf[STATE_DISPLAY_OFFSET], chip8->display);
+}
+
+// Serialize architectural state into buf, returns the state size or 0 if buf is too small
+size_t serialize_state(const chip8_t *chip8, uint8_t *buf, const size_t buf_size) {
+    const uint8_t *base = chip8->rom->image;
+
+    if (buf_size < STATE_FIXED_SIZE) return 0;
+    serialize_header(chip8, buf);
+
+    // RAM diff runs against the boot image
+    size_t pos = STATE_FIXED_SIZE;
+    uint16_t runs = 0;
+
+    for (uint32_t i = 0; i < CHIP8_RAM_SIZE; ) {
+        // Skip whole blocks that match the boot image, from a block boundary
+        if (i % RAM_BLOCK == 0 && memcmp(&chip8->ram[i], &base[i], RAM_BLOCK) == 0) {
+            i += RAM_BLOCK;
+            continue;
+        }
+        if (chip8->ram[i] == base[i]) {
+            i++;
+            continue;
+        }
+
+        // Extend the run until RAM_RUN_GAP bytes in a row match the boot image
+        uint32_t end = i + 1, equal = 0;
+        while (end < CHIP8_RAM_SIZE && equal < RAM_RUN_GAP) {
+            equal = (chip8->ram[end] == base[end]) ? equal + 1 : 0;
+            end++;
+        }
+        end -= equal;
+
+        const uint32_t len = end - i;
+        if (pos + 4 + len > buf_size) return 0;
+
+        put_u16(&buf[pos], (uint16_t)i);
+        put_u16(&buf[pos + 2], (uint16_t)len);
+        memcpy(&buf[pos + 4], &chip8->ram[i], len);
+        pos += 4 + len;
+        runs++;
+
+        i = end;    // Carry on after the run, possibly in a later block
+    }
+    put_u16(&buf[STATE_FIXED_SIZE - 2], runs);
+
+    return pos;
+}
+
+// Restore architectural state from buf, the machine must already be running the same ROM.
+//   On failure the machine is left unchanged.
+bool deserialize_state(chip8_t *chip8, const uint8_t *buf, const size_t size) {
+    const rom_t *rom = chip8->rom;
+
+    if (size < STATE_FIXED_SIZE || memcmp(&buf[0], STATE_MAGIC, 4) != 0) {
+        fprintf(stderr, "Not a CHIP8 save state\n");
+        return false;
+    }
+
+    const uint16_t version = get_u16(&buf[4]);
+    if (version == 0 || version > CHIP8_STATE_VERSION) {
+        fprintf(stderr, "Unsupported save state version %u\n", version);
+        return false;
+    }
+
+    if (get_u32(&buf[8]) != rom->hash || get_u16(&buf[12]) != rom->size) {
+        fprintf(stderr, "Save state was made with a different ROM than %s\n", rom->name);
+        return false;
+    }
+
+    // Validate RAM diff runs before touching the machine
+    const uint16_t runs = get_u16(&buf[STATE_FIXED_SIZE - 2]);
+    size_t pos = STATE_FIXED_SIZE;
+    for (uint16_t r = 0; r < runs; r++) {
+        if (pos + 4 > size) {
+            fprintf(stderr, "Truncated save state\n");
+            return false;
+        }
+        const uint16_t offset = get_u16(&buf[pos]);
+        const uint16_t len = get_u16(&buf[pos + 2]);
+        if ((uint32_t)offset + len > CHIP8_RAM_SIZE || pos + 4 + len > size) {
+            fprintf(stderr, "Corrupt save state RAM diff\n");
+            return false;
+        }
+        pos += 4 + len;
+    }
+
+    if (buf[18] > 12) {
+        fprintf(stderr, "Corrupt save state stack pointer\n");
+        return false;
+    }
+
+    if (version >= 2 && buf[21] != 0xFF && buf[21] > 0xF) {
+        fprintf(stderr, "Corrupt save state FX0A key\n");
+        return false;
+    }
+
+    deserialize_header(chip8, buf);
+
+    memcpy(chip8->ram, rom->image, CHIP8_RAM_SIZE);
+    pos = STATE_FIXED_SIZE;
+    for (uint16_t r = 0; r < runs; r++) {
+        const uint16_t offset = get_u16(&buf[pos]);
+        const uint16_t len = get_u16(&buf[pos + 2]);
+        memcpy(&chip8->ram[offset], &buf[pos + 4], len);
+        pos += 4 + len;
+    }
+    sync_ram_guard(chip8);
+
+    chip8->draw = true;     // Redraw restored display
+    return true;
+}
+
+// Write a whole file atomically: write to a temp file next to it, flush to disk, then
+//   rename over the destination, so a crash never leaves a half written file behind
+bool write_file_atomic(const char *filename, const uint8_t *buf, const size_t size) {
+    char temp_name[FILENAME_MAX];
+    if (snprintf(temp_name, sizeof temp_name, "%s.tmp", filename) >= (int)sizeof temp_name) 
+        return false;
+
+    FILE *file = fopen(temp_name, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file %s for writing\n", temp_name);
+        return false;
+    }
+
+    bool ok = fwrite(buf, size, 1, file) == 1 && fflush(file) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    if (fclose(file) != 0) ok = false;
+
+    if (ok) {
+#ifdef _WIN32
+        ok = MoveFileExA(temp_name, filename, MOVEFILE_REPLACE_EXISTING);
+#else
+        ok = rename(temp_name, filename) == 0;
+#endif
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        remove(temp_name);
+    }
+    return ok;
+}
+
+// Save Chip8 state to file
+bool save_state(const chip8_t *chip8, const char *filename) {
+    uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    const size_t size = serialize_state(chip8, buf, sizeof buf);
+    if (size == 0) return false;
+
+    return write_file_atomic(filename, buf, size);
+}
+
+// Load Chip8 state from file
+bool load_state(chip8_t *chip8, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file %s for loading state\n", filename);
+        return false;
+    }
+
+    uint8_t buf[CHIP8_STATE_MAX_SIZE];
+    const size_t size = fread(buf, 1, sizeof buf, file);
+    fclose(file);
+
+    return deserialize_state(chip8, buf, size);
+}
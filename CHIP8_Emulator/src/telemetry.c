@@ -0,0 +1,140 @@
+#include "telemetry.h"
+
+const char *phase_names[PHASE_COUNT] = {
+    "input", "emulate", "timers", "snapshot", "sleep", "render", "present", "frame",
+};
+
+static int bit_length(uint64_t value) {
+    int bits = 0;
+    for (; value; value >>= 1) bits++;
+    return bits;
+}
+
+// Values under 8 get their own bucket, above that each power of 2 is split in 8
+static uint32_t bucket_index(const uint64_t ns) {
+    if (ns < 8) return (uint32_t)ns;
+    const int msb = bit_length(ns) - 1;
+    return (msb - 2) * 8 + ((ns >> (msb - 3)) & 7);
+}
+
+// Middle of the range of values in a bucket
+static uint64_t bucket_value(const uint32_t index) {
+    if (index < 8) return index;
+    const int msb = index / 8 + 2;
+    const uint64_t width = 1ull << (msb - 3);
+    return (8 + index % 8) * width + width / 2;
+}
+
+static void histogram_add(histogram_t *hist, const uint64_t ns) {
+    hist->buckets[bucket_index(ns)]++;
+    hist->count++;
+    if (ns > hist->max) hist->max = ns;
+}
+
+static uint64_t histogram_percentile(const histogram_t *hist, const double percentile) {
+    if (hist->count == 0) return 0;
+
+    const uint64_t target = (uint64_t)(hist->count * percentile / 100.0);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < TELEMETRY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > target) {
+            const uint64_t value = bucket_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void telemetry_init(telemetry_t *telemetry, const uint32_t interval_ms) {
+    memset(telemetry, 0, sizeof *telemetry);
+    telemetry->interval_ns = (uint64_t)interval_ms * 1000000;
+    telemetry->window_start = monotonic_ns();
+}
+
+void telemetry_begin_frame(telemetry_t *telemetry) {
+    telemetry->frame_start = telemetry->last_mark = monotonic_ns();
+    telemetry->frame_sleep_ns = 0;
+}
+
+// End of a phase, everything since the last mark is counted against it
+void telemetry_mark(telemetry_t *telemetry, const phase_t phase) {
+    const uint64_t now = monotonic_ns();
+    const uint64_t ns = now - telemetry->last_mark;
+    histogram_add(&telemetry->phases[phase], ns);
+    telemetry->last_mark = now;
+
+    if (phase == PHASE_SLEEP) telemetry->frame_sleep_ns += ns;
+    if (phase == PHASE_EMULATE) telemetry->window_emulate_ns += ns;
+}
+
+// Summarize the window and start a new one
+static void roll_window(telemetry_t *telemetry, const uint64_t now) {
+    const double seconds = (now - telemetry->window_start) / 1e9;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        const histogram_t *hist = &telemetry->phases[phase];
+        telemetry->stats[phase] = (phase_stats_t){
+            .p50 = histogram_percentile(hist, 50),
+            .p99 = histogram_percentile(hist, 99),
+            .max = hist->max,
+        };
+    }
+
+    telemetry->mips = telemetry->window_emulate_ns ? 
+                      telemetry->window_insts * 1e3 / telemetry->window_emulate_ns : 0.0;
+    telemetry->fps = seconds > 0 ? telemetry->window_frames / seconds : 0.0;
+    telemetry->dropped = telemetry->window_dropped;
+
+    memset(telemetry->phases, 0, sizeof telemetry->phases);
+    telemetry->window_start = now;
+    telemetry->window_insts = telemetry->window_frames = telemetry->window_dropped = 0;
+    telemetry->window_emulate_ns = 0;
+}
+
+// Finish a frame that ran insts instructions. Returns true when a window ended and new 
+//   stats are available.
+bool telemetry_end_frame(telemetry_t *telemetry, const uint32_t insts) {
+    const uint64_t now = monotonic_ns();
+
+    // Frame work, not counting time spent sleeping
+    const uint64_t work = now - telemetry->frame_start - telemetry->frame_sleep_ns;
+    histogram_add(&telemetry->phases[PHASE_FRAME], work);
+
+    if (work > TELEMETRY_FRAME_NS) {
+        telemetry->window_dropped++;
+        telemetry->total_dropped++;
+    }
+    telemetry->window_insts += insts;
+    telemetry->window_frames++;
+
+    if (now - telemetry->window_start < telemetry->interval_ns) return false;
+    roll_window(telemetry, now);
+    return true;
+}
+
+// Write the last window's stats as JSON. This runs on the emulator thread, so it's a single
+//   small write without the fsync a save state gets.
+bool telemetry_write(const telemetry_t *telemetry, const char *filename) {
+    char buf[2048];
+    int len = snprintf(buf, sizeof buf, 
+                       "{\n  \"mips\": %.2f,\n  \"fps\": %.2f,\n  \"dropped\": %llu,\n"
+                       "  \"total_dropped\": %llu,\n  \"audio_latency_us\": %u,\n  \"phases_ns\": {",
+                       telemetry->mips, telemetry->fps, (long long unsigned)telemetry->dropped,
+                       (long long unsigned)telemetry->total_dropped, telemetry->audio_latency_us);
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        const phase_stats_t *stats = &telemetry->stats[phase];
+        len += snprintf(&buf[len], sizeof buf - len, 
+                        "%s\n    \"%s\": {\"p50\": %llu, \"p99\": %llu, \"max\": %llu}",
+                        phase ? "," : "", phase_names[phase], (long long unsigned)stats->p50,
+                        (long long unsigned)stats->p99, (long long unsigned)stats->max);
+    }
+    len += snprintf(&buf[len], sizeof buf - len, "\n  }\n}\n");
+
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+    const bool ok = fwrite(buf, 1, len, file) == (size_t)len;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Frame timing telemetry: the main loop marks the end of each phase of a frame with a 
+//   monotonic timestamp, the time since the previous mark goes into that phase's histogram.
+//   Histograms cover a rolling window (config stats_interval_ms) and are summarized to 
+//   p50/p99/max when the window ends. A frame costs a handful of clock reads.
+
+#include "chip8.h"
+
+#define TELEMETRY_BUCKETS 512   // Log scale buckets, 8 per power of 2
+#define TELEMETRY_FRAME_NS 16666667ull  // 60hz frame budget
+
+typedef enum {
+    PHASE_INPUT,        // handle_input
+    PHASE_EMULATE,      // Instructions for this frame
+    PHASE_TIMERS,       // update_timers and sound events
+    PHASE_SNAPSHOT,     // Rewind snapshot
+    PHASE_SLEEP,        // Waiting for the next 60hz tick
+    PHASE_RENDER,       // update_screen and the overlay
+    PHASE_PRESENT,      // SDL_RenderPresent
+    PHASE_FRAME,        // Whole frame minus sleep
+    PHASE_COUNT,
+} phase_t;
+
+typedef struct {
+    uint32_t buckets[TELEMETRY_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} histogram_t;
+
+typedef struct {
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+} phase_stats_t;
+
+struct telemetry {
+    histogram_t phases[PHASE_COUNT];    // Current window
+    uint64_t interval_ns;
+    uint64_t window_start;
+    uint64_t window_insts;
+    uint64_t window_frames;
+    uint64_t window_dropped;
+    uint64_t window_emulate_ns;
+    uint64_t frame_start;
+    uint64_t frame_sleep_ns;
+    uint64_t last_mark;
+
+    // Summary of the last complete window, in ns
+    phase_stats_t stats[PHASE_COUNT];
+    double mips;            // Instructions per second of emulate phase time, in millions
+    double fps;
+    uint64_t dropped;       // Frames over budget in the last window
+    uint64_t total_dropped;
+    uint32_t audio_latency_us;  // Smoothed sound event -> playback latency, 0 without audio
+};
+
+extern const char *phase_names[PHASE_COUNT];
+
+void telemetry_init(telemetry_t *telemetry, const uint32_t interval_ms);
+void telemetry_begin_frame(telemetry_t *telemetry);
+void telemetry_mark(telemetry_t *telemetry, const phase_t phase);
+bool telemetry_end_frame(telemetry_t *telemetry, const uint32_t insts);
+bool telemetry_write(const telemetry_t *telemetry, const char *filename);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,226 @@
+#include <stdarg.h>
+
+#include "trace.h"
+
+// Trace file format, all fields little endian:
+//
+//   offset  size  field
+//   0       4     magic "C8TR"
+//   4       2     format version (TRACE_FILE_VERSION)
+//   6       2     reserved (0)
+//   8       4     number of entries, oldest first
+//   12      4     reserved (0)
+//   16      ...   entries: PC (2), opcode (2), I (2), return address (2), VX, VY, V0,
+//                   delay timer, key state (1 each), reserved (3)
+
+// What describe_instruction appends after the text, from the entry's register values
+typedef enum {
+    SHOW_NOTHING,
+    SHOW_RETURN,    // Return address
+    SHOW_ADD_NN,    // VX + NN
+    SHOW_OR,        // VX | VY
+    SHOW_AND,       // VX & VY
+    SHOW_XOR,       // VX ^ VY
+    SHOW_ADD,       // VX + VY and carry
+    SHOW_SUB,       // VX - VY and no borrow
+    SHOW_SHR,       // VX >> 1 and the bit shifted off
+    SHOW_SUBN,      // VY - VX and no borrow
+    SHOW_SHL,       // VX << 1 and the bit shifted off
+    SHOW_JUMP,      // V0 + NNN
+    SHOW_KEY,       // Keypad state of the key in VX
+    SHOW_ADD_I,     // I + VX
+    SHOW_FONT,      // Font sprite address for VX
+} show_t;
+
+// Every instruction's wording, shared by the trace (with register values) and the
+//   disassembler (without). In the text $X and $Y are register numbers, $N, $B and $A the
+//   N, NN and NNN fields, and $x, $y, $0, $i and $d the values of VX, VY, V0, I and the delay
+//   timer, left out when there are no values to show.
+static const struct {
+    uint16_t mask;
+    uint16_t match;
+    const char *text;
+    show_t show;
+} instructions[] = {
+    {0xFFFF, 0x00E0, "Clear screen", SHOW_NOTHING},
+    {0xFFFF, 0x00EE, "Return from subroutine", SHOW_RETURN},
+    {0xF000, 0x1000, "Jump to address NNN ($A)", SHOW_NOTHING},
+    {0xF000, 0x2000, "Call subroutine at NNN ($A)", SHOW_NOTHING},
+    {0xF000, 0x3000, "Check if V$X$x == NN ($B), skip next instruction if true", SHOW_NOTHING},
+    {0xF000, 0x4000, "Check if V$X$x != NN ($B), skip next instruction if true", SHOW_NOTHING},
+    {0xF00F, 0x5000, "Check if V$X$x == V$Y$y, skip next instruction if true", SHOW_NOTHING},
+    {0xF000, 0x6000, "Set register V$X = NN ($B)", SHOW_NOTHING},
+    {0xF000, 0x7000, "Set register V$X$x += NN ($B)", SHOW_ADD_NN},
+    {0xF00F, 0x8000, "Set register V$X = V$Y$y", SHOW_NOTHING},
+    {0xF00F, 0x8001, "Set register V$X$x |= V$Y$y", SHOW_OR},
+    {0xF00F, 0x8002, "Set register V$X$x &= V$Y$y", SHOW_AND},
+    {0xF00F, 0x8003, "Set register V$X$x ^= V$Y$y", SHOW_XOR},
+    {0xF00F, 0x8004, "Set register V$X$x += V$Y$y, VF = 1 if carry", SHOW_ADD},
+    {0xF00F, 0x8005, "Set register V$X$x -= V$Y$y, VF = 1 if no borrow", SHOW_SUB},
+    {0xF00F, 0x8006, "Set register V$X$x >>= 1, VF = shifted off bit", SHOW_SHR},
+    {0xF00F, 0x8007, "Set register V$X = V$Y$y - V$X$x, VF = 1 if no borrow", SHOW_SUBN},
+    {0xF00F, 0x800E, "Set register V$X$x <<= 1, VF = shifted off bit", SHOW_SHL},
+    {0xF00F, 0x9000, "Check if V$X$x != V$Y$y, skip next instruction if true", SHOW_NOTHING},
+    {0xF000, 0xA000, "Set I to NNN ($A)", SHOW_NOTHING},
+    {0xF000, 0xB000, "Set PC to V0$0 + NNN ($A)", SHOW_JUMP},
+    {0xF000, 0xC000, "Set V$X = random & NN ($B)", SHOW_NOTHING},
+    {0xF000, 0xD000, "Draw N ($N) height sprite at coords V$X$x, V$Y$y from memory location I$i", SHOW_NOTHING},
+    {0xF0FF, 0xE09E, "Skip next instruction if key in V$X$x is pressed", SHOW_KEY},
+    {0xF0FF, 0xE0A1, "Skip next instruction if key in V$X$x is not pressed", SHOW_KEY},
+    {0xF0FF, 0xF007, "Set V$X = delay timer value$d", SHOW_NOTHING},
+    {0xF0FF, 0xF00A, "Await until a key is pressed; Store key in V$X", SHOW_NOTHING},
+    {0xF0FF, 0xF015, "Set delay timer value = V$X$x", SHOW_NOTHING},
+    {0xF0FF, 0xF018, "Set sound timer value = V$X$x", SHOW_NOTHING},
+    {0xF0FF, 0xF01E, "I$i += V$X$x", SHOW_ADD_I},
+    {0xF0FF, 0xF029, "Set I to sprite location in memory for character in V$X$x", SHOW_FONT},
+    {0xF0FF, 0xF033, "Store BCD representation of V$X$x at memory from I$i", SHOW_NOTHING},
+    {0xF0FF, 0xF055, "Register dump V0-V$X inclusive at memory from I$i", SHOW_NOTHING},
+    {0xF0FF, 0xF065, "Register load V0-V$X inclusive at memory from I$i", SHOW_NOTHING},
+};
+
+// snprintf onto the end of buf, stopping quietly once it's full
+static void append(char *buf, const size_t size, size_t *len, const char *fmt, ...) {
+    if (*len >= size) return;
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(&buf[*len], size - *len, fmt, args);
+    va_end(args);
+    if (n > 0) *len += (size_t)n;
+}
+
+// Describe opcode from the instructions table, with register values from e unless it's NULL
+static void describe(const uint16_t opcode, const trace_entry_t *e, char *buf, const size_t size) {
+    const uint16_t NNN = opcode & 0x0FFF;
+    const uint8_t NN = opcode & 0x0FF;
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+
+    size_t i = 0;
+    while (i < sizeof instructions / sizeof instructions[0] &&
+           (opcode & instructions[i].mask) != instructions[i].match)
+        i++;
+    if (i == sizeof instructions / sizeof instructions[0]) {
+        snprintf(buf, size, "Unimplemented Opcode.");
+        return;
+    }
+
+    size_t len = 0;
+    buf[0] = '\0';
+    for (const char *c = instructions[i].text; *c; c++) {
+        if (*c != '$') {
+            append(buf, size, &len, "%c", *c);
+            continue;
+        }
+        switch (*++c) {
+            case 'X': append(buf, size, &len, "%X", X); break;
+            case 'Y': append(buf, size, &len, "%X", Y); break;
+            case 'N': append(buf, size, &len, "%u", opcode & 0xF); break;
+            case 'B': append(buf, size, &len, "0x%02X", NN); break;
+            case 'A': append(buf, size, &len, "0x%04X", NNN); break;
+            case 'x': if (e) append(buf, size, &len, " (0x%02X)", e->VX); break;
+            case 'y': if (e) append(buf, size, &len, " (0x%02X)", e->VY); break;
+            case '0': if (e) append(buf, size, &len, " (0x%02X)", e->V0); break;
+            case 'i': if (e) append(buf, size, &len, " (0x%04X)", e->I); break;
+            case 'd': if (e) append(buf, size, &len, " (0x%02X)", e->delay); break;
+        }
+    }
+    if (!e) return;
+
+    switch (instructions[i].show) {
+        case SHOW_NOTHING: break;
+        case SHOW_RETURN: append(buf, size, &len, " to address 0x%04X", e->ret); break;
+        case SHOW_ADD_NN: append(buf, size, &len, "; Result: 0x%02X", (e->VX + NN) & 0xFF); break;
+        case SHOW_OR:     append(buf, size, &len, "; Result: 0x%02X", e->VX | e->VY); break;
+        case SHOW_AND:    append(buf, size, &len, "; Result: 0x%02X", e->VX & e->VY); break;
+        case SHOW_XOR:    append(buf, size, &len, "; Result: 0x%02X", e->VX ^ e->VY); break;
+        case SHOW_ADD:
+            append(buf, size, &len, "; Result: 0x%02X, VF = %X",
+                   (e->VX + e->VY) & 0xFF, e->VX + e->VY > 255);
+            break;
+        case SHOW_SUB:
+            append(buf, size, &len, "; Result: 0x%02X, VF = %X", (e->VX - e->VY) & 0xFF, e->VY <= e->VX);
+            break;
+        case SHOW_SHR:
+            append(buf, size, &len, "; Result: 0x%02X, VF = %X", e->VX >> 1, e->VX & 1);
+            break;
+        case SHOW_SUBN:
+            append(buf, size, &len, "; Result: 0x%02X, VF = %X", (e->VY - e->VX) & 0xFF, e->VX <= e->VY);
+            break;
+        case SHOW_SHL:
+            append(buf, size, &len, "; Result: 0x%02X, VF = %X", (e->VX << 1) & 0xFF, e->VX >> 7);
+            break;
+        case SHOW_JUMP:   append(buf, size, &len, "; Result: PC = 0x%04X", e->V0 + NNN); break;
+        case SHOW_KEY:    append(buf, size, &len, "; Keypad value: %d", e->key); break;
+        case SHOW_ADD_I:  append(buf, size, &len, "; Result: I = 0x%04X", (e->I + e->VX) & 0xFFFF); break;
+        case SHOW_FONT:   append(buf, size, &len, "; Result: I = 0x%04X", e->VX * 5); break;
+    }
+}
+
+void describe_instruction(const trace_entry_t *e, char *buf, const size_t size) {
+    describe(e->opcode, e, buf, size);
+}
+
+void disassemble_opcode(const uint16_t opcode, char *buf, const size_t size) {
+    describe(opcode, NULL, buf, size);
+}
+
+static void put_entry(uint8_t *buf, const trace_entry_t *entry) {
+    put_u16(&buf[0], entry->PC);
+    put_u16(&buf[2], entry->opcode);
+    put_u16(&buf[4], entry->I);
+    put_u16(&buf[6], entry->ret);
+    buf[8] = entry->VX;
+    buf[9] = entry->VY;
+    buf[10] = entry->V0;
+    buf[11] = entry->delay;
+    buf[12] = entry->key;
+    memset(&buf[13], 0, 3);
+}
+
+// Write the last count instructions (or all there are) to filename, oldest first
+bool trace_dump(const trace_t *trace, const char *filename, uint32_t count) {
+    const uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    if (count > TRACE_SIZE) count = TRACE_SIZE;
+    if (count > head) count = (uint32_t)head;
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", filename);
+        return false;
+    }
+
+    uint8_t header[TRACE_FILE_HEADER_SIZE] = {0};
+    memcpy(&header[0], TRACE_FILE_MAGIC, 4);
+    put_u16(&header[4], TRACE_FILE_VERSION);
+    put_u32(&header[8], count);
+    fwrite(header, 1, sizeof header, file);
+
+    for (uint64_t seq = head - count; seq < head; seq++) {
+        uint8_t buf[TRACE_FILE_ENTRY_SIZE];
+        put_entry(buf, &trace->entries[seq & (TRACE_SIZE - 1)]);
+        fwrite(buf, 1, sizeof buf, file);
+    }
+
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Read the next entry of a trace file, after its header
+bool trace_read_entry(FILE *file, trace_entry_t *entry) {
+    uint8_t buf[TRACE_FILE_ENTRY_SIZE];
+    if (fread(buf, 1, sizeof buf, file) != sizeof buf) return false;
+
+    *entry = (trace_entry_t){
+        .PC = get_u16(&buf[0]),
+        .opcode = get_u16(&buf[2]),
+        .I = get_u16(&buf[4]),
+        .ret = get_u16(&buf[6]),
+        .VX = buf[8],
+        .VY = buf[9],
+        .V0 = buf[10],
+        .delay = buf[11],
+        .key = buf[12],
+    };
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Instruction trace: with -DTRACE every executed instruction is recorded into a ring as a 
+//   small binary entry holding what its description needs. Entries are turned into text 
+//   only when the ring is dumped and decoded offline (tracedump.c), so tracing is cheap 
+//   enough to leave on while playing.
+
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+#define TRACE_SIZE 65536            // Entries in the ring, power of 2
+#define TRACE_DESC_SIZE 192         // Big enough for any instruction description
+#define TRACE_FILE_MAGIC "C8TR"
+#define TRACE_FILE_VERSION 1
+#define TRACE_FILE_HEADER_SIZE 16
+#define TRACE_FILE_ENTRY_SIZE 16
+
+// One executed instruction, with register values from before it ran
+typedef struct {
+    uint16_t PC;
+    uint16_t opcode;
+    uint16_t I;
+    uint16_t ret;           // Top of stack, return address for 00EE
+    uint8_t VX;
+    uint8_t VY;
+    uint8_t V0;             // For BNNN
+    uint8_t delay;          // Delay timer, for FX07
+    uint8_t key;            // Keypad state of the key in VX, for EX9E/EXA1
+    uint8_t reserved[3];
+} trace_entry_t;
+
+struct trace {
+    trace_entry_t entries[TRACE_SIZE];
+    _Atomic uint64_t head;  // Total entries written, the newest is at head - 1
+};
+
+// Fill entry from the instruction just fetched into chip8->inst
+static inline void trace_capture(const chip8_t *chip8, trace_entry_t *entry) {
+    const uint8_t X = chip8->inst.X;
+    *entry = (trace_entry_t){
+        .PC = chip8->PC - 2,
+        .opcode = chip8->inst.opcode,
+        .I = chip8->I,
+        .ret = chip8->SP ? chip8->stack[(chip8->SP - 1) % CHIP8_STACK_SIZE] : 0,
+        .VX = chip8->V[X],
+        .VY = chip8->V[chip8->inst.Y],
+        .V0 = chip8->V[0],
+        .delay = chip8->delay_timer,
+        .key = chip8->keypad[chip8->V[X] & 0xF],
+    };
+}
+
+// Record the instruction just fetched. Only the emulator thread writes, readers use head
+//   to find the newest entries.
+static inline void trace_record(trace_t *trace, const chip8_t *chip8) {
+    const uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    trace_capture(chip8, &trace->entries[head & (TRACE_SIZE - 1)]);
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+// Human readable description of an instruction, as printed by -DDEBUG builds
+void describe_instruction(const trace_entry_t *e, char *buf, const size_t size);
+
+// The same description without register values, for disassembling
+void disassemble_opcode(const uint16_t opcode, char *buf, const size_t size);
+
+bool trace_dump(const trace_t *trace, const char *filename, uint32_t count);
+bool trace_read_entry(FILE *file, trace_entry_t *entry);
+
+#endif // TRACE_H
@@ -0,0 +1,43 @@
+#include "trace.h"
+
+// Decode a trace file written with -DTRACE (F8 in the SDL frontend) into the same text
+//   -DDEBUG builds print for every instruction
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace_file> [--last N]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t last = UINT32_MAX;
+    if (argc >= 4 && strcmp(argv[2], "--last") == 0) 
+        last = (uint32_t)strtoul(argv[3], NULL, 10);
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open trace file %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t header[TRACE_FILE_HEADER_SIZE];
+    if (fread(header, 1, sizeof header, file) != sizeof header || 
+        memcmp(header, TRACE_FILE_MAGIC, 4) != 0 || get_u16(&header[4]) != TRACE_FILE_VERSION) {
+        fprintf(stderr, "%s is not a version %d trace file\n", argv[1], TRACE_FILE_VERSION);
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+
+    // Skip to the last N entries
+    const uint32_t count = get_u32(&header[8]);
+    if (last < count) 
+        fseek(file, (long)(count - last) * TRACE_FILE_ENTRY_SIZE, SEEK_CUR);
+
+    trace_entry_t entry;
+    char desc[TRACE_DESC_SIZE];
+    while (trace_read_entry(file, &entry)) {
+        describe_instruction(&entry, desc, sizeof desc);
+        printf("Address: 0x%04X, Opcode: 0x%04X Desc: %s\n", entry.PC, entry.opcode, desc);
+    }
+
+    fclose(file);
+    exit(EXIT_SUCCESS);
+}
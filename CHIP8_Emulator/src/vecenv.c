@@ -0,0 +1,273 @@
+#include <unistd.h>
+
+#include "vecenv.h"
+
+void vecenv_default_options(vecenv_options_t *options, const uint32_t num_envs) {
+    memset(options, 0, sizeof *options);
+    options->num_envs = num_envs;
+    options->frames_per_step = 4;   // 15 decisions a second, like most Atari setups
+    options->obs_type = VECENV_OBS_PACKED;
+    options->downsample = 2;
+    options->reward.scale = 1.0f;
+    options->auto_reset = true;
+
+    char *no_args[] = {"vecenv"};
+    set_config_from_args(&options->config, 1, no_args, NULL);
+}
+
+// splitmix64, so neighbouring seeds give unrelated machines
+static uint64_t mix_seed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static int64_t read_score(const vecenv_t *env, const chip8_t *chip8) {
+    const vecenv_reward_t *reward = &env->options.reward;
+    int64_t score = 0;
+    for (uint8_t i = 0; i < reward->bytes; i++) {
+        const uint8_t byte = chip8->ram[(reward->address + i) & CHIP8_RAM_MASK];
+        score = reward->bcd ? score * 10 + byte : (score << 8) | byte;
+    }
+    return score;
+}
+
+static bool episode_done(const vecenv_t *env, const uint32_t i) {
+    const vecenv_done_t *done = &env->options.done;
+    const chip8_t *chip8 = &env->envs[i];
+
+    // Out of range accesses wrap here, so nothing pauses a machine, but don't step one that did
+    return chip8->state != RUNNING ||
+           (done->mask && (chip8->ram[done->address & CHIP8_RAM_MASK] & done->mask) == done->value) ||
+           (env->options.max_frames && env->frames[i] >= env->options.max_frames);
+}
+
+// Write one environment's observation, from its display straight into the caller's buffer
+static void write_obs(const vecenv_t *env, const chip8_t *chip8, uint8_t *obs) {
+    if (env->options.obs_type == VECENV_OBS_PACKED) {
+        pack_display(chip8->display, obs);
+        return;
+    }
+
+    // Each cell is the share of its pixels lit, scaled to 0-255
+    const uint32_t factor = env->options.downsample;
+    const uint32_t cells = factor * factor;
+    for (uint32_t y = 0; y < 32 / factor; y++) {
+        for (uint32_t x = 0; x < 64 / factor; x++) {
+            uint32_t lit = 0;
+            for (uint32_t dy = 0; dy < factor; dy++)
+                for (uint32_t dx = 0; dx < factor; dx++)
+                    lit += chip8->display[(y * factor + dy) * 64 + x * factor + dx];
+            *obs++ = lit * 255 / cells;
+        }
+    }
+}
+
+static void reset_env(vecenv_t *env, const uint32_t i) {
+    config_t config = env->options.config;
+    config.rng_seed = env->seeds[i];
+    env->seeds[i] = mix_seed(env->seeds[i]);
+
+    init_chip8(&env->envs[i], config, env->rom);
+    env->scores[i] = read_score(env, &env->envs[i]);
+    env->frames[i] = 0;
+}
+
+// Reset or step environments first..last - 1 of the current job
+static void run_envs(vecenv_t *env, const uint32_t first, const uint32_t last) {
+    for (uint32_t i = first; i < last; i++) {
+        chip8_t *chip8 = &env->envs[i];
+        uint8_t *obs = env->obs + i * env->obs_size;
+
+        if (env->resetting) {
+            reset_env(env, i);
+            write_obs(env, chip8, obs);
+            continue;
+        }
+
+        // A finished episode stays finished until it's reset
+        if (episode_done(env, i)) {
+            env->rewards[i] = 0.0f;
+            env->dones[i] = true;
+            write_obs(env, chip8, obs);
+            continue;
+        }
+
+        for (int key = 0; key < 16; key++)
+            chip8->keypad[key] = (env->actions[i] >> key) & 1;
+        for (uint32_t frame = 0; frame < env->options.frames_per_step && chip8->state == RUNNING; frame++) {
+            emulate_frame(chip8, env->options.config, NULL);
+            env->frames[i]++;
+        }
+
+        const int64_t score = read_score(env, chip8);
+        env->rewards[i] = env->options.reward.scale * (float)(score - env->scores[i]);
+        env->scores[i] = score;
+        env->dones[i] = episode_done(env, i);
+
+        if (env->dones[i] && env->options.auto_reset) reset_env(env, i);
+        write_obs(env, chip8, obs);
+    }
+}
+
+// Thread t's share of the environments, contiguous so each thread keeps to its own machines
+static void run_share(vecenv_t *env, const uint32_t t) {
+    const uint32_t n = env->options.num_envs;
+    run_envs(env, (uint64_t)n * t / env->threads, (uint64_t)n * (t + 1) / env->threads);
+}
+
+typedef struct {
+    vecenv_t *env;
+    uint32_t index;
+} worker_arg_t;
+
+static void *worker(void *arg) {
+    worker_arg_t *worker_arg = arg;
+    vecenv_t *env = worker_arg->env;
+    const uint32_t index = worker_arg->index;
+    free(worker_arg);
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&env->lock);
+    for (;;) {
+        while (env->generation == seen && !env->quit)
+            pthread_cond_wait(&env->start, &env->lock);
+        if (env->quit) break;
+        seen = env->generation;
+        pthread_mutex_unlock(&env->lock);
+
+        run_share(env, index);
+
+        pthread_mutex_lock(&env->lock);
+        if (--env->pending == 0) pthread_cond_signal(&env->finished);
+    }
+    pthread_mutex_unlock(&env->lock);
+    return NULL;
+}
+
+// Run the current job on all threads, the caller's thread takes share 0
+static void run_job(vecenv_t *env) {
+    pthread_mutex_lock(&env->lock);
+    env->pending = env->threads - 1;
+    env->generation++;
+    pthread_cond_broadcast(&env->start);
+    pthread_mutex_unlock(&env->lock);
+
+    run_share(env, 0);
+
+    pthread_mutex_lock(&env->lock);
+    while (env->pending)
+        pthread_cond_wait(&env->finished, &env->lock);
+    pthread_mutex_unlock(&env->lock);
+}
+
+bool vecenv_init(vecenv_t *env, const vecenv_options_t *options, const rom_t *rom) {
+    memset(env, 0, sizeof *env);
+    env->options = *options;
+    env->rom = rom;
+
+    vecenv_options_t *opts = &env->options;
+    if (opts->num_envs == 0 || opts->reward.bytes > 4 ||
+        (opts->obs_type == VECENV_OBS_DOWNSAMPLED &&
+         opts->downsample != 2 && opts->downsample != 4 && opts->downsample != 8)) {
+        fprintf(stderr, "Invalid vecenv options\n");
+        return false;
+    }
+    if (opts->frames_per_step == 0) opts->frames_per_step = 1;
+    env->obs_size = opts->obs_type == VECENV_OBS_PACKED ? 64*32 / 8 :
+                    (64 / opts->downsample) * (32 / opts->downsample);
+
+    // Machines run on any thread, so nothing in the config can be shared state, and out of
+    //   range accesses just wrap instead of printing or pausing
+    opts->config.debugger = NULL;
+    opts->config.telemetry = NULL;
+#ifdef PROFILE
+    opts->config.profile = NULL;
+#endif
+#ifdef TRACE
+    opts->config.trace = NULL;
+#endif
+    for (int profile = CHIP8; profile <= XOCHIP; profile++)
+        opts->config.oob_policy[profile] = OOB_WRAP;
+
+    uint32_t threads = opts->threads;
+    if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (uint32_t)cores : 1;
+#else
+        threads = 1;
+#endif
+    }
+    if (threads > opts->num_envs) threads = opts->num_envs;
+
+    env->envs = calloc(opts->num_envs, sizeof *env->envs);
+    env->scores = calloc(opts->num_envs, sizeof *env->scores);
+    env->frames = calloc(opts->num_envs, sizeof *env->frames);
+    env->seeds = calloc(opts->num_envs, sizeof *env->seeds);
+    env->workers = calloc(threads, sizeof *env->workers);
+    if (!env->envs || !env->scores || !env->frames || !env->seeds || !env->workers) {
+        fprintf(stderr, "Could not allocate %u environments\n", opts->num_envs);
+        vecenv_free(env);
+        return false;
+    }
+
+    pthread_mutex_init(&env->lock, NULL);
+    pthread_cond_init(&env->start, NULL);
+    pthread_cond_init(&env->finished, NULL);
+
+    // Fewer threads than asked for if some won't start, the shares just get bigger
+    env->threads = 1;
+    for (uint32_t t = 1; t < threads; t++) {
+        worker_arg_t *arg = malloc(sizeof *arg);
+        if (!arg) break;
+        *arg = (worker_arg_t){env, t};
+        if (pthread_create(&env->workers[t], NULL, worker, arg) != 0) {
+            free(arg);
+            break;
+        }
+        env->threads++;
+    }
+
+    return true;    // Success
+}
+
+void vecenv_free(vecenv_t *env) {
+    if (env->workers && env->threads) {
+        pthread_mutex_lock(&env->lock);
+        env->quit = true;
+        pthread_cond_broadcast(&env->start);
+        pthread_mutex_unlock(&env->lock);
+        for (uint32_t t = 1; t < env->threads; t++) pthread_join(env->workers[t], NULL);
+
+        pthread_cond_destroy(&env->finished);
+        pthread_cond_destroy(&env->start);
+        pthread_mutex_destroy(&env->lock);
+    }
+
+    free(env->envs);
+    free(env->scores);
+    free(env->frames);
+    free(env->seeds);
+    free(env->workers);
+    memset(env, 0, sizeof *env);
+}
+
+void vecenv_reset(vecenv_t *env, const uint64_t seed, uint8_t *obs) {
+    for (uint32_t i = 0; i < env->options.num_envs; i++)
+        env->seeds[i] = mix_seed(seed + i);
+
+    env->resetting = true;
+    env->obs = obs;
+    run_job(env);
+    env->resetting = false;
+}
+
+void vecenv_step(vecenv_t *env, const uint16_t *actions, uint8_t *obs, float *rewards, bool *dones) {
+    env->actions = actions;
+    env->obs = obs;
+    env->rewards = rewards;
+    env->dones = dones;
+    run_job(env);
+}
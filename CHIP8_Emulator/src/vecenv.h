@@ -0,0 +1,99 @@
+#ifndef VECENV_H
+#define VECENV_H
+
+// Vectorized environment for reinforcement learning, gym style: N machines running the same
+//   ROM, stepped together. An action is the keypad held for the step (bit N for key N), the
+//   reward is the change of a score read from RAM and an episode is done when a RAM byte
+//   matches or it ran max_frames. Observations are written
+//   straight from chip8_t.display into one caller buffer, obs_size bytes per environment.
+//   Steps run across worker threads, each thread owning a contiguous range of environments.
+//
+//   vecenv_t env;
+//   vecenv_init(&env, &options, &rom);
+//   vecenv_reset(&env, seed, obs);
+//   while (training) {
+//       ...pick actions[N] from obs...
+//       vecenv_step(&env, actions, obs, rewards, dones);
+//   }
+//   vecenv_free(&env);
+
+#include <pthread.h>
+
+#include "chip8.h"
+
+typedef enum {
+    VECENV_OBS_PACKED,      // 64x32, 1 bit per pixel, MSB first, row major: 256 bytes
+    VECENV_OBS_DOWNSAMPLED, // (64 / downsample) x (32 / downsample), 1 byte per cell, 0-255 lit
+} vecenv_obs_t;
+
+// Score in RAM: bytes big endian binary, or BCD digits one per byte as FX33 stores them
+typedef struct {
+    uint16_t address;
+    uint8_t bytes;          // 1-4, 0 for no score (reward always 0)
+    bool bcd;
+    float scale;            // Reward = scale * (score after the step - score before)
+} vecenv_reward_t;
+
+// Episode ends when (ram[address] & mask) == value, a mask of 0 never matches
+typedef struct {
+    uint16_t address;
+    uint8_t mask;
+    uint8_t value;
+} vecenv_done_t;
+
+typedef struct {
+    uint32_t num_envs;
+    uint32_t threads;           // Worker threads including the caller's, 0 for one per core
+    uint32_t frames_per_step;   // 60hz frames each step runs with the action held, at least 1
+    uint64_t max_frames;        // Episode length limit, 0 for none
+    vecenv_obs_t obs_type;
+    uint32_t downsample;        // 2, 4 or 8 for VECENV_OBS_DOWNSAMPLED
+    vecenv_reward_t reward;
+    vecenv_done_t done;
+    bool auto_reset;            // Done environments reset in the same step, obs is the new episode's
+    config_t config;            // Quirks, speed etc. every machine runs with
+} vecenv_options_t;
+
+typedef struct {
+    vecenv_options_t options;
+    const rom_t *rom;
+    size_t obs_size;            // Bytes of observation per environment
+
+    chip8_t *envs;
+    int64_t *scores;            // Score after each environment's last step
+    uint64_t *frames;           // Frames into each environment's episode
+    uint64_t *seeds;            // Each environment's next episode seed
+
+    // Current job, set by the caller's thread before waking the workers
+    const uint16_t *actions;
+    uint8_t *obs;
+    float *rewards;
+    bool *dones;
+    bool resetting;
+
+    pthread_t *workers;
+    uint32_t threads;           // Including the caller's
+    pthread_mutex_t lock;
+    pthread_cond_t start;       // Workers wait for a new generation
+    pthread_cond_t finished;    // The caller waits for all workers to finish it
+    uint64_t generation;
+    uint32_t pending;           // Workers still running the current generation
+    bool quit;
+} vecenv_t;
+
+// Set up options with defaults for num_envs environments
+void vecenv_default_options(vecenv_options_t *options, const uint32_t num_envs);
+
+bool vecenv_init(vecenv_t *env, const vecenv_options_t *options, const rom_t *rom);
+void vecenv_free(vecenv_t *env);
+
+// Boot every environment, environment i with an RNG seed derived from seed and i.
+//   Writes the first observations to obs, num_envs * obs_size bytes.
+void vecenv_reset(vecenv_t *env, const uint64_t seed, uint8_t *obs);
+
+// Run frames_per_step frames on every environment holding actions[i], then write obs,
+//   rewards[num_envs] and dones[num_envs]. Done environments without auto_reset keep their
+//   final state, and report done with 0 reward, until vecenv_reset.
+void vecenv_step(vecenv_t *env, const uint16_t *actions, uint8_t *obs, float *rewards, bool *dones);
+
+#endif // VECENV_H